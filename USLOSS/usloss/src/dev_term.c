@@ -14,9 +14,11 @@ typedef struct {
     FILE	*outputPtr;	/* output stream. */
     int		status;		/* its status register. */
     int		control;	/* its control register. */
+    int		at_eof;		/* last poll found no input. */
 } TermInfo;
 
 static TermInfo terms[USLOSS_TERM_UNITS];
+static int poll_unit = -1;	/* the unit term_action() polled last. */
 
 /* 
  * Handy macros.
@@ -187,17 +189,18 @@ dynamic_dcl int term_request(int unit, void *arg)
  */
 dynamic_dcl int term_action(void *arg)
 {
-    static int unit = -1;
+    int unit;
     int in_char;
     int result = -1;
 
     /*  Select the pseudoterminal to read from and get next character */ 
-    unit = (unit + 1) % 4;
+    unit = poll_unit = (poll_unit + 1) % 4;
     //printf("term_action %d\n", unit);
     //print_status(terms[unit].status);
     //print_control(terms[unit].control);
 
     in_char = nextchr(terms[unit].inputPtr);
+    terms[unit].at_eof = (in_char == EOF);
     //terms[unit].status = 0;
 
     /*  If we are not at EOF or the character is not an '@' sign (which
@@ -232,3 +235,28 @@ dynamic_dcl int term_action(void *arg)
     return result;
 }
 
+/*
+ *  Does the next terminal poll, if it cannot raise an interrupt, for
+ *  idle_forward(). Returns FALSE without polling if it might: the unit is
+ *  sending, or has receive interrupts on and input left. A unit with
+ *  receive interrupts on at EOF is passed over rather than read, so input
+ *  appended to its file meanwhile waits for the next real poll instead of
+ *  being lost.
+ */
+dynamic_dcl int term_poll_quiet(void)
+{
+    TermInfo *term = &terms[(poll_unit + 1) % 4];
+
+    if (USLOSS_TERM_STAT_XMIT(term->status) == USLOSS_DEV_BUSY) {
+	return FALSE;
+    }
+    if (term->control & 0x2) {
+	if (!term->at_eof) {
+	    return FALSE;
+	}
+	poll_unit = (poll_unit + 1) % 4;
+	return TRUE;
+    }
+    (void) term_action(NULL);
+    return TRUE;
+}
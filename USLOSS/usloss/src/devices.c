@@ -7,6 +7,7 @@
 #include "dev_clock.h"
 #include "dev_disk.h"
 #include "dev_term.h"
+#include "sig_ints.h"
 
 static struct {
     int		device;
@@ -15,6 +16,15 @@ static struct {
 				// 256 (major changes if not) */
 
 static unsigned char dev_event_ptr;	/*  Index into queue of pending ints */
+static unsigned int tick = 0;		/*  Alarms alternate: clock, device slot */
+
+/*
+ *  Longest stretch, in ticks, between two clock interrupts when
+ *  idle_forward() skips ahead. Kernels wake clock waiters (sleepd) every
+ *  100ms of USLOSSClock() time; keeping each stretch to 100ms means they
+ *  still see one such period per interrupt, so none is lost.
+ */
+#define IDLE_MAX_TICKS (100000 / ALARM_TIME)
 
 void (*USLOSS_IntVec[USLOSS_NUM_INTS])(int dev, void *arg);	/*  Interrupt vector table */
      
@@ -71,7 +81,6 @@ dynamic_fun void schedule_int(int device, void *arg, int future_time)
  */
 dynamic_fun void dispatch_int(void)
 {
-    static unsigned int tick = 0;
     int event_device;
     int unit_num = -1;
     void *arg;
@@ -139,6 +148,40 @@ dynamic_fun void dispatch_int(void)
     }
 }
 
+/*
+ *  Idle fast-forward for virtual-time mode, called by USLOSS_WaitInt()
+ *  before it raises the next alarm. Nothing is runnable, so the clock
+ *  interrupts are only there to let time pass. When the next alarm is a
+ *  clock interrupt, skip pairs of alarms (a device slot and a clock
+ *  interrupt) ahead of it, as long as the device slot has no scheduled
+ *  event and its terminal poll cannot interrupt; the poll is still done,
+ *  so terminal input is consumed as before. The next alarm then delivers
+ *  one clock interrupt for the whole stretch.
+ */
+dynamic_fun void idle_forward(void)
+{
+    int enabled;
+    int ticks;
+
+    enabled = int_off();
+    if (!tick) {
+	/*  A stretch ends with a device slot and the clock interrupt, a
+	    tick each */
+	for (ticks = 2; ticks + 2 <= IDLE_MAX_TICKS; ticks += 2) {
+	    if (dev_event_queue[(unsigned char) (dev_event_ptr + 1)].device != LOW_PRI_DEV ||
+		!term_poll_quiet()) {
+		break;
+	    }
+	    dev_event_ptr++;
+	    pclock_ticks += 2;
+	    partial_ticks = 0;
+	}
+    }
+    if (enabled) {
+	int_on();
+    }
+}
+
 /*
  *  Perform the inp() operation, which returns the status of a device.  We
  *  call on a per-device basis because the device may clear its status when
@@ -148,6 +191,7 @@ int USLOSS_DeviceInput(unsigned int dev, int unit, int *statusPtr)
 {
     int result = USLOSS_DEV_INVALID;
     check_kernel_mode("USLOSS_DeviceInput");
+    charge(COST_DEVICE);
     switch(dev)
     {
       case USLOSS_CLOCK_DEV:
@@ -177,6 +221,7 @@ int USLOSS_DeviceOutput(unsigned int dev, int unit, void *arg)
     int		result = USLOSS_DEV_ERROR;
 
     check_kernel_mode("USLOSS_DeviceOutput");
+    charge(COST_DEVICE);
     switch(dev)
     {
       case USLOSS_CLOCK_DEV:
@@ -12,6 +12,7 @@ dynamic_dcl int device_status[USLOSS_NUM_INTS];
 dynamic_dcl void devices_init(void);
 dynamic_dcl void schedule_int(int device, void *arg, int future_time);
 dynamic_dcl void dispatch_int(void);
+dynamic_dcl void idle_forward(void);
 
 #endif	/*  _devices_h */
 
@@ -58,46 +58,31 @@ void psr_valid(void)
 
 unsigned int USLOSS_PsrGet(void) 
 {
-    unsigned int result;
-    int enabled;
-
-    enabled = int_off();
-    check_interrupts();
     psr_valid();
-    result = current_psr & USLOSS_PSR_MASK;
-    if (enabled) {
-	int_on();
-    }
-    return result;
+    return current_psr & USLOSS_PSR_MASK;
 }
 
 
 int USLOSS_PsrSet(unsigned int new)
 {
     LOG(PSR_SET_VERBOSITY, "Setting PSR to 0x%02x\n", new);
-    int status;
     check_kernel_mode("USLOSS_PsrSet");
-    (void) int_off();
-    check_interrupts();
     psr_valid();
     // disallow setting upper bits
     if (new & ~USLOSS_PSR_MASK) {
-        status = USLOSS_ERR_INVALID_PSR;
-        goto done;
+        return USLOSS_ERR_INVALID_PSR;
     }
     // disallow running in user mode w/ interrupts disabled
     if ((new & USLOSS_PSR_CURRENT_MASK) == 0) {
-        status = USLOSS_ERR_INVALID_PSR;
-        goto done;
+        return USLOSS_ERR_INVALID_PSR;
     }
     current_psr = USLOSS_PSR_MAGIC | new;
+    charge(COST_CALL);
+    // interrupts are masked in software; take any that came in while they were off
     if (current_psr & USLOSS_PSR_CURRENT_INT) {
-	   int_on();
+        take_pending();
     }
-    check_interrupts();
-    status = USLOSS_ERR_OK;
-done:
-    return status;
+    return USLOSS_ERR_OK;
 }
 
 /*
@@ -156,10 +141,15 @@ int USLOSSClock(void)
 
     check_kernel_mode("USLOSS_Clock");
     enabled = int_off();
-    partial_ticks += atleast(5);
-    if (partial_ticks >= ALARM_TIME) {
-	   pclock_ticks++;
-	   partial_ticks -= ALARM_TIME;
+    if (deterministic_time) {
+	   /*  The alarm this may raise rolls the tick over at int_on() */
+	   charge(COST_CALL);
+    } else {
+	   partial_ticks += atleast(5);
+	   if (partial_ticks >= ALARM_TIME) {
+	       pclock_ticks++;
+	       partial_ticks -= ALARM_TIME;
+	   }
     }
     value =  pclock_ticks * ALARM_TIME + partial_ticks;  /* syscalls per tick */
     if (enabled) {
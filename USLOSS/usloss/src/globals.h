@@ -21,6 +21,8 @@ dynamic_dcl int dumpcore;
 #define USLOSS_PSR_MAGIC 0x45200
 
 extern int virtual_time;
+extern int deterministic_time;
+extern int use_swapcontext;
 extern int SIG_ALARM;
 
 #define TRUE 1
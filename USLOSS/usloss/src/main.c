@@ -31,6 +31,13 @@ static void print_options()
     printf("  -h, --help               Print list of options and exit.\n");
     printf("  -r, --real-time          Set USLOSS to use real time. This is the default mode.\n");
     printf("  -R, --virtual-time       Set USLOSS to use virtual time.\n");
+    printf("  -D, --deterministic      Set USLOSS to use deterministic time: the clock advances only\n");
+    printf("                           by fixed costs charged per event, so runs repeat exactly.\n");
+    printf("                           A loop that makes no USLOSS calls takes no time.\n");
+    printf("  -c, --costs=LIST         Set deterministic time costs, in ns, and imply -D. LIST is\n");
+    printf("                           comma-separated EVENT=NS; events and defaults: call=1000\n");
+    printf("                           (PsrSet, Clock), syscall=5000, switch=10000, device=20000.\n");
+    printf("  -s, --swapcontext        Switch contexts with swapcontext() instead of the fast path.\n");
     printf("  -v, --verbose            Increase the verbosity level of USLOSS. The verbosity level\n");
     printf("                           is equal to the number of times this option is set.\n");
     printf("                           LEVELS:\n");
@@ -41,21 +48,27 @@ static void print_options()
 }
 
 // global flags
-int verbosity, virtual_time, SIG_ALARM;
+int verbosity, virtual_time, deterministic_time, use_swapcontext, SIG_ALARM;
 
 int main(int argc, char **argv)
 {
     // Parse args
     verbosity = 0;
     virtual_time = FALSE;
+    deterministic_time = FALSE;
+    use_swapcontext = FALSE;
     int opt;
     struct option longopt[] = {
         {"verbose", no_argument, NULL, 'v'},
         {"real-time", no_argument, NULL, 'r'},
         {"virtual-time", no_argument, NULL, 'R'},
-        {"help", no_argument, NULL, 'h'}
+        {"deterministic", no_argument, NULL, 'D'},
+        {"costs", required_argument, NULL, 'c'},
+        {"swapcontext", no_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
     };
-    while ((opt = getopt_long(argc, argv, "vrRh", longopt, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "vrRDc:sh", longopt, NULL)) != -1) {
         switch(opt) {
             case 'v':
                 verbosity++;
@@ -66,12 +79,31 @@ int main(int argc, char **argv)
             case 'R':
                 virtual_time = TRUE;
                 break;
+            case 'D':
+                deterministic_time = TRUE;
+                break;
+            case 'c':
+                if (!cost_set(optarg)) {
+                    fprintf(stderr, "USLOSS: bad cost list '%s'\n", optarg);
+                    print_options();
+                    return 1;
+                }
+                deterministic_time = TRUE;
+                break;
+            case 's':
+                use_swapcontext = TRUE;
+                break;
             case 'h':
                 print_options();
                 return 0;
         }
     }
 
+    // deterministic time idles the way virtual time does
+    if (deterministic_time) {
+        virtual_time = TRUE;
+    }
+
     // SIG_ALARM is now defined at runtime
     SIG_ALARM = virtual_time ? SIGVTALRM : SIGALRM;
 
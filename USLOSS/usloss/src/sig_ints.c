@@ -15,21 +15,86 @@
 #include <fcntl.h>
 
 #include <sys/time.h>
+#include <stdint.h>
+#include <string.h>
 
 #define NUM_SIG 100
 
-static void             *syscall_arg = NULL;
-
-// Values for trap_pending
-
-#define SYSCALL_PENDING 1
-#define ILLEGAL_PENDING 2
-static int              trap_pending = 0;
-
 struct sigaction        old_actions[NUM_SIG];
 
 static USLOSS_Context           *launch_context;
 
+/*
+ *  Interrupts are masked in software; the host's signal mask is never
+ *  changed. A SIG_ALARM that arrives while the PSR has interrupts off, or
+ *  while USLOSS is inside int_off()/int_on(), only sets irq_pending.
+ *  take_pending() delivers it as soon as neither holds: from int_on(), from
+ *  USLOSS_PsrSet() when it turns interrupts on, and on the way out of a
+ *  trap. Several alarms that arrive
+ *  while masked fold into one, as they did when the signal was blocked.
+ */
+static volatile sig_atomic_t    ints_masked = FALSE;
+static volatile sig_atomic_t    irq_pending = FALSE;
+
+/*
+ *  Fast context switch. swapcontext() saves and restores the signal mask,
+ *  which costs a sigprocmask() call on each side, plus the full register
+ *  and FPU state. USLOSS never changes the signal mask (interrupts are
+ *  masked in software, below), and a switch is a call site, so only the
+ *  callee-saved registers, the MXCSR/x87 control words and the stack
+ *  pointer need to move. The saved stack pointer lives in the context's
+ *  ucontext_t, which the fast path does not otherwise use, so usloss.h
+ *  does not change. Other hosts, and -s, use swapcontext().
+ */
+#if defined(__x86_64__) && defined(__ELF__)
+#define FAST_SWITCH 1
+
+typedef struct fast_ctx {
+    void        *sp;            /* top of the registers saved by fast_swap */
+} fast_ctx;
+
+#define FAST_CTX(ctx) ((fast_ctx *) &(ctx)->context)
+
+/*  Saves the current registers on the stack and the stack pointer in
+    *save_sp, then loads load_sp and returns into whatever saved it. */
+void usloss_fast_swap(void **save_sp, void *load_sp);
+
+__asm__(
+    "    .text\n"
+    "    .globl  usloss_fast_swap\n"
+    "    .hidden usloss_fast_swap\n"
+    "    .type   usloss_fast_swap, @function\n"
+    "usloss_fast_swap:\n"
+    "    pushq   %rbp\n"
+    "    pushq   %rbx\n"
+    "    pushq   %r12\n"
+    "    pushq   %r13\n"
+    "    pushq   %r14\n"
+    "    pushq   %r15\n"
+    "    subq    $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw  4(%rsp)\n"
+    "    movq    %rsp, (%rdi)\n"
+    "    movq    %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw   4(%rsp)\n"
+    "    addq    $8, %rsp\n"
+    "    popq    %r15\n"
+    "    popq    %r14\n"
+    "    popq    %r13\n"
+    "    popq    %r12\n"
+    "    popq    %rbx\n"
+    "    popq    %rbp\n"
+    "    ret\n"
+    "    .size   usloss_fast_swap, .-usloss_fast_swap\n"
+);
+
+/*  Number of words usloss_fast_swap pushes: six registers and the control words */
+#define FAST_SAVED_WORDS 7
+#else
+#define FAST_SWITCH 0
+#endif
+
 /*  
  *  Timer setup code.
  */
@@ -40,6 +105,11 @@ dynamic_fun void set_timer(void)
 {
     static struct itimerval value, ovalue;
 
+    /*  In deterministic time the alarms come from charge(), not the host */
+    if (deterministic_time) {
+        return;
+    }
+
     /*  Set up virtual interrupt timer */
     value.it_interval.tv_sec = 0;
     value.it_interval.tv_usec = ALARM_TIME;
@@ -68,12 +138,89 @@ dynamic_fun void stop_timer(void)
     }
 }
 
+/*
+ *  Deterministic time (-D). Simulated time advances only by the cost,
+ *  in nanoseconds, charged for each of these events, and an alarm is
+ *  raised every ALARM_TIME microseconds charged. Kernel work in between
+ *  is approximated by the number of USLOSS calls it makes, so a loop that
+ *  makes none takes no time. Waiting for an interrupt skips to the next
+ *  alarm, as in virtual time.
+ */
+static struct {
+    char	*name;
+    int		ns;
+} costs[COST_NUM] = {
+    [COST_CALL]		= { "call",	 1000 },	/* USLOSS_PsrSet(), USLOSS_Clock() */
+    [COST_SYSCALL]	= { "syscall",	 5000 },	/* USLOSS_Syscall() */
+    [COST_SWITCH]	= { "switch",	10000 },	/* USLOSS_ContextSwitch() */
+    [COST_DEVICE]	= { "device",	20000 },	/* USLOSS_DeviceInput/Output() */
+};
+static int charged_ns;		/* charged but not yet a whole microsecond */
+
+/*
+ *  Sets costs from a list like "switch=2000,call=500". Returns FALSE if
+ *  the list is malformed or names an unknown event.
+ */
+dynamic_fun int cost_set(char *list)
+{
+    char *copy, *item, *save, *value, *end;
+    int event;
+    long ns;
+    int ok = TRUE;
+
+    copy = strdup(list);
+    usloss_sys_assert(copy != NULL, "out of memory in cost_set");
+    for (item = strtok_r(copy, ",", &save); ok && item != NULL;
+         item = strtok_r(NULL, ",", &save)) {
+        value = strchr(item, '=');
+        if (value == NULL) {
+            ok = FALSE;
+            break;
+        }
+        *value++ = '\0';
+        for (event = 0; event < COST_NUM; event++) {
+            if (strcmp(costs[event].name, item) == 0) {
+                break;
+            }
+        }
+        ns = strtol(value, &end, 10);
+        if (event == COST_NUM || end == value || *end != '\0' ||
+            ns < 0 || ns > ALARM_TIME * 1000L) {
+            ok = FALSE;
+            break;
+        }
+        costs[event].ns = ns;
+    }
+    free(copy);
+    return ok;
+}
+
+/*
+ *  Charges one event to the clock in deterministic time, raising the
+ *  alarm once a tick's worth has been charged. Does nothing otherwise.
+ */
+dynamic_fun void charge(int event)
+{
+    if (!deterministic_time) {
+        return;
+    }
+    charged_ns += costs[event].ns;
+    partial_ticks += charged_ns / 1000;
+    charged_ns %= 1000;
+    if (partial_ticks >= ALARM_TIME) {
+        irq_pending = TRUE;
+        take_pending();
+    }
+}
+
 static void launcher(void) {
     void (*func)(void);
 
     assert(launch_context != NULL);
     func = launch_context->start;
     launch_context = NULL;
+    /*  The switch that got here was made inside int_off() */
+    int_on();
     (*func)();
     rpt_sim_trap("context's initial function returned!\n");
 }
@@ -95,6 +242,31 @@ void USLOSS_ContextInit(USLOSS_Context *ctx, char *stack, int stackSize, USLOSS_
     if (stackSize < USLOSS_MIN_STACK) {
         rpt_sim_trap("USLOSS_ContextInit: stackSize < USLOSS_MIN_STACK\n");
     }
+#if FAST_SWITCH
+    if (!use_swapcontext) {
+        /*
+         *  Build the frame usloss_fast_swap expects, so that the first
+         *  switch to this context "returns" into launcher with the stack
+         *  aligned as if launcher had been called.
+         */
+        void **sp = (void **) (((uintptr_t) stack + stackSize) & ~(uintptr_t) 15);
+        unsigned int ctl[2] = { 0, 0 };
+
+        *--sp = NULL;                   /* launcher's return address; it never returns */
+        *--sp = (void *) launcher;
+        sp -= FAST_SAVED_WORDS;
+        memset(sp, 0, FAST_SAVED_WORDS * sizeof(void *));
+        __asm__ volatile ("stmxcsr %0\n\tfnstcw %1" : "=m" (ctl[0]), "=m" (ctl[1]));
+        memcpy(sp, ctl, sizeof(ctl));
+        FAST_CTX(ctx)->sp = sp;
+        ctx->pageTable = pageTable;
+        ctx->start = pc;
+        if (enabled) {
+            int_on();
+        }
+        return;
+    }
+#endif
     err_return = getcontext(&ctx->context);            
     usloss_sys_assert(err_return != -1, "INTERNAL ERROR: getcontext failed in USLOSS_ContextInit");
     ctx->context.uc_stack.ss_sp = stack;
@@ -108,63 +280,83 @@ void USLOSS_ContextInit(USLOSS_Context *ctx, char *stack, int stackSize, USLOSS_
     }
 }
 
+/*
+ *  Takes a device or clock interrupt, in kernel mode with interrupts off.
+ */
+static void take_alarm(void)
+{
+    int old_psr = current_psr;
+
+    current_psr = USLOSS_PSR_MAGIC | ((current_psr & USLOSS_PSR_CURRENT_MASK) << 2);
+    current_psr |= USLOSS_PSR_CURRENT_MODE;
+    USLOSSwaiting = 0;    /*  or make this conditional depending on terminal? */
+    pclock_ticks++;
+    /*  Deterministic time may have charged past the tick; keep the rest */
+    partial_ticks = partial_ticks >= ALARM_TIME ? partial_ticks - ALARM_TIME : 0;
+    dispatch_int();
+    if ((current_psr & ~USLOSS_PSR_MASK) != USLOSS_PSR_MAGIC) {
+        usloss_assert(0, "corrupted psr");
+    }
+    current_psr = old_psr;
+}
+
+/*
+ *  Delivers the interrupt in irq_pending, if interrupts are no longer masked.
+ *  The flag is tested and cleared in one exchange: the handlers are
+ *  SA_NODEFER, so an alarm arriving between a separate test and clear
+ *  would be delivered twice.
+ */
+dynamic_fun void take_pending(void)
+{
+    while (!ints_masked && (current_psr & USLOSS_PSR_CURRENT_INT) &&
+           __atomic_exchange_n(&irq_pending, FALSE, __ATOMIC_SEQ_CST)) {
+        take_alarm();
+    }
+}
+
+/*
+ *  Enters the kernel through USLOSS_IntVec[intnum], the way a trap
+ *  instruction would: kernel mode with interrupts off, the old mode and
+ *  interrupt bits kept in the previous fields, and all of it put back when
+ *  the handler returns. System calls and illegal instructions are
+ *  synchronous, so this is a plain call rather than a signal.
+ */
+static void take_trap(int intnum, void *arg)
+{
+    int old_psr = current_psr;
+
+    current_psr = USLOSS_PSR_MAGIC | ((current_psr & USLOSS_PSR_CURRENT_MASK) << 2);
+    current_psr |= USLOSS_PSR_CURRENT_MODE;
+    (*USLOSS_IntVec[intnum])(intnum, arg);
+    if ((current_psr & ~USLOSS_PSR_MASK) != USLOSS_PSR_MAGIC) {
+        usloss_assert(0, "corrupted psr");
+    }
+    current_psr = old_psr;
+    /*  An interrupt that came in during the trap is taken on the way out */
+    take_pending();
+}
+
 /*
  *  The handler for the virtual timer interrupts (among others).
  */
 static void sighandler(int sig, siginfo_t *sigstuff, void *oldcontext)
 {
     int old_psr = current_psr;
-    void *arg;
-
-    /*  We are now in kernel mode - set psr accordingly */
 
     psr_valid();
+    /*  Changed SIG_ALARM to be decided at runtime so it needs to use an if */
+    if (sig == SIG_ALARM) {   /*  Device or clock interrupt - to dispatch routine */
+        irq_pending = TRUE;
+        take_pending();
+        return;
+    }
+
+    /*  We are now in kernel mode - set psr accordingly */
     current_psr = USLOSS_PSR_MAGIC | ((current_psr & USLOSS_PSR_CURRENT_MASK) << 2);
     current_psr |= USLOSS_PSR_CURRENT_MODE;
     check_interrupts();
-    /*  Switch depending upon what type of signal this is - SIGUSR1 is used
-        for system calls, SIG_ALARM is used for devices */
-    /*  Changed SIG_ALARM to be decided at runtime so it needs to use an if */
-    if (sig == SIG_ALARM) {   /*  Device or clock interrupt - to dispatch routine */
-        USLOSSwaiting = 0;    /*  or make this conditional depending on terminal? */
-        pclock_ticks++;
-        partial_ticks = 0;
-        if (trap_pending) {
-            goto done;
-        }
-        dispatch_int();
-    } else {
     switch(sig)
     {
-      case SIGUSR1:
-        usloss_assert(trap_pending != 0, "no trap pending?");
-        if (trap_pending == SYSCALL_PENDING) {
-            arg = syscall_arg;
-            trap_pending = 0;
-            if (USLOSS_IntVec[USLOSS_SYSCALL_INT] == NULL) {
-                rpt_sim_trap("USLOSS_IntVec[USLOSS_SYSCALL_INT] is NULL!\n");
-            }
-            int sysnum;
-            if (arg == NULL) {
-                LOG(INT_VERBOSITY, "Warning: Syscall arg is NULL\n");
-                sysnum = -1;
-            } else {
-                sysnum = ((USLOSS_Sysargs*)arg)->number;
-            }
-            LOG(INT_VERBOSITY, "Interrupt: %d (SYSCALL %d), handler @ %p\n",
-                USLOSS_SYSCALL_INT, sysnum, USLOSS_IntVec[USLOSS_SYSCALL_INT]);
-            // call syscall handler
-            (*USLOSS_IntVec[USLOSS_SYSCALL_INT])(USLOSS_SYSCALL_INT, arg);
-        } else if (trap_pending == ILLEGAL_PENDING) {
-            LOG(INT_VERBOSITY, "Interrupt: %d (ILLEGAL), handler @ %p\n",
-                USLOSS_ILLEGAL_INT, USLOSS_IntVec[USLOSS_ILLEGAL_INT]);
-            trap_pending = 0;
-            if (USLOSS_IntVec[USLOSS_ILLEGAL_INT] == NULL) {
-                rpt_sim_trap("USLOSS_IntVec[USLOSS_ILLEGAL_INT] is NULL!\n");
-            }
-            (*USLOSS_IntVec[USLOSS_ILLEGAL_INT])(USLOSS_ILLEGAL_INT, NULL);
-        }
-        break;
       case SIGSEGV:
       case SIGBUS:
 #ifdef MMU
@@ -177,16 +369,16 @@ static void sighandler(int sig, siginfo_t *sigstuff, void *oldcontext)
         vrpt_cond("Bad signal");
         break;
     } // end switch
-    } // end else
 
     /*  Finished with any interrupt handling - reset variables, set up the
         timer for the next interrupt, and go back to the specified context */
-done:
     check_interrupts();
     if ((current_psr & ~USLOSS_PSR_MASK) != USLOSS_PSR_MAGIC) {
         usloss_assert(0, "corrupted psr");
     }
     current_psr = old_psr;
+    /*  An interrupt that came in during the fault is taken on the way out */
+    take_pending();
 #ifdef MMU
     if (mmuInTouch) {
         siglongjmp(mmuTouchBuf, 1);
@@ -211,6 +403,7 @@ void USLOSS_ContextSwitch(USLOSS_Context *old_context, USLOSS_Context *new_conte
     enabled = int_off();
     check_kernel_mode("USLOSS_ContextSwitch");
     check_interrupts();
+    charge(COST_SWITCH);
     if (new_context == NULL) {
         rpt_sim_trap("USLOSS_ContextSwitch: new_context is NULL.\n");
     }
@@ -233,6 +426,18 @@ void USLOSS_ContextSwitch(USLOSS_Context *old_context, USLOSS_Context *new_conte
             }
         }
     }
+#if FAST_SWITCH
+    if (!use_swapcontext) {
+        static fast_ctx discard;
+
+        usloss_fast_swap(old_context ? &FAST_CTX(old_context)->sp : &discard.sp,
+                         FAST_CTX(new_context)->sp);
+        if (enabled) {
+            int_on();
+        }
+        return;
+    }
+#endif
     if (old_context == NULL) {
         err_return = setcontext(&new_context->context);
     } else {
@@ -250,44 +455,29 @@ void USLOSS_ContextSwitch(USLOSS_Context *old_context, USLOSS_Context *new_conte
  *  Interrupt enable/disable/check section
  */
 
-static sigset_t timer_set;
-
 /*
- *  This is called to block delivery of SIG_ALARM to the process, thereby
- *  disabling USLOSS interrupts.
+ *  This is called to keep USLOSS interrupts out of a USLOSS critical
+ *  section. Returns TRUE if they were not already kept out, in which case
+ *  the caller must call int_on() when it is done.
  */
 
 int int_off(void)
 {
-    int err_return;
     int enabled;
-    sigset_t cur_set;
 
-    err_return = sigprocmask(SIG_BLOCK, &timer_set, &cur_set);
-    usloss_sys_assert(err_return != -1, "error disabling interrupts");
-    enabled = sigismember(&cur_set, SIG_ALARM) ? FALSE : TRUE;
+    enabled = !ints_masked;
+    ints_masked = TRUE;
     return enabled;
 }
 
 /*
- *  This is called to permit delivery of SIG_ALARM to the process, thereby
- *  enabling USLOSS interrupts.
- *
- *  I modified the timer_set to include SIGUSR1, otherwise when switching to a new context
- *  from an interrupt handler and enabling interrupts SIGUSR1 could be left blocked because
- *  it is in the sa_mask and therefore blocked when the signal handler is invoked. Something
- *  must have changed in the way Linux/Unix handles signal masks. JHH 3/9/09
+ *  This is called at the end of a critical section, and takes any interrupt
+ *  that arrived during it if the PSR has interrupts on.
  */
 void int_on(void) 
 {
-    int err_return;
-    sigset_t cur_set;
-
-    err_return = sigprocmask(SIG_UNBLOCK, &timer_set, NULL);
-    usloss_sys_assert(err_return != -1, "error enabling interrupts");
-    err_return = sigprocmask(SIG_BLOCK, NULL, &cur_set);
-    usloss_sys_assert(err_return != -1, "error checking signals");
-    usloss_sys_assert(sigismember(&cur_set, SIGUSR1) == 0, "SIGUSR1 is blocked");
+    ints_masked = FALSE;
+    take_pending();
 }
 
 
@@ -304,6 +494,7 @@ void USLOSS_WaitInt(void)
     USLOSSwaiting = 1;
     while (USLOSSwaiting) {
         if (virtual_time) {
+            idle_forward();
             raise(SIG_ALARM);
         } else {
             pause();
@@ -312,60 +503,50 @@ void USLOSS_WaitInt(void)
 }
 
 /*
- * System call. The trap_pending flag is a total hack. Without it
- * a SIG_ALARM signal might show up after the SIGUSR1 signal has been
- * posted but before the signal handler is called. The alarm signal
- * may cause a context switch, causing the wrong process to get the
- * system call signal. I'm not sure why system calls are implemented
- * using signals anyway. jhh 4/5/95
+ * System call. This used to raise(SIGUSR1) and enter the kernel from the
+ * signal handler, with a trap_pending flag to keep a clock interrupt from
+ * slipping in between and delivering the call to the wrong process. A
+ * trap is synchronous, so it is now a direct call; an interrupt that
+ * arrives before take_trap() changes the PSR is simply taken first, as it
+ * would be before a trap instruction.
  */
 void USLOSS_Syscall(void *arg)
 {
-    int err_return;
-    int enabled;
-    sigset_t cur_set;
-
     if (current_psr & USLOSS_PSR_CURRENT_MODE) {
         USLOSS_Console("FATAL ERROR: Invoking USLOSS_Syscall from kernel mode.\n");
         abort();
     }
-    /*
-     * Make sure SIGUSR1 is not blocked.
-     */
-    err_return = sigprocmask(SIG_BLOCK, NULL, &cur_set);
-    usloss_sys_assert(err_return != -1, "error checking signal mask");
-    enabled = sigismember(&cur_set, SIGUSR1) ? FALSE : TRUE;
-    if (enabled == FALSE) {
-        USLOSS_Console("INTERNAL ERROR: USLOSS_Syscall: invoking raise() with SIGUSR1 blocked.\n");
-        abort();
+    if (USLOSS_IntVec[USLOSS_SYSCALL_INT] == NULL) {
+        rpt_sim_trap("USLOSS_IntVec[USLOSS_SYSCALL_INT] is NULL!\n");
+    }
+    if (verbosity >= INT_VERBOSITY) {
+        int sysnum;
+        if (arg == NULL) {
+            LOG(INT_VERBOSITY, "Warning: Syscall arg is NULL\n");
+            sysnum = -1;
+        } else {
+            sysnum = ((USLOSS_Sysargs*)arg)->number;
+        }
+        LOG(INT_VERBOSITY, "Interrupt: %d (SYSCALL %d), handler @ %p\n",
+            USLOSS_SYSCALL_INT, sysnum, USLOSS_IntVec[USLOSS_SYSCALL_INT]);
     }
-    trap_pending = SYSCALL_PENDING;
-    syscall_arg = arg;
-    raise(SIGUSR1);
+    /*  An alarm the entry cost raises is taken before the trap */
+    charge(COST_SYSCALL);
+    take_trap(USLOSS_SYSCALL_INT, arg);
 }
 
 void USLOSS_IllegalInstruction(void)
 {
-    int err_return;
-    int enabled;
-    sigset_t cur_set;
-
     if (current_psr & USLOSS_PSR_CURRENT_MODE) {
         USLOSS_Console("FATAL ERROR: Invoking USLOSS_IllegalInstruction from kernel mode.\n");
         abort();
     }
-    /*
-     * Make sure SIGUSR1 is not blocked.
-     */
-    err_return = sigprocmask(SIG_BLOCK, NULL, &cur_set);
-    usloss_sys_assert(err_return != -1, "error checking signal mask");
-    enabled = sigismember(&cur_set, SIGUSR1) ? FALSE : TRUE;
-    if (enabled == FALSE) {
-        USLOSS_Console("INTERNAL ERROR: USLOSS_IllegalInstruction: invoking raise() with SIGUSR1 blocked.\n");
-        abort();
+    LOG(INT_VERBOSITY, "Interrupt: %d (ILLEGAL), handler @ %p\n",
+        USLOSS_ILLEGAL_INT, USLOSS_IntVec[USLOSS_ILLEGAL_INT]);
+    if (USLOSS_IntVec[USLOSS_ILLEGAL_INT] == NULL) {
+        rpt_sim_trap("USLOSS_IntVec[USLOSS_ILLEGAL_INT] is NULL!\n");
     }
-    trap_pending = ILLEGAL_PENDING;
-    raise(SIGUSR1);
+    take_trap(USLOSS_ILLEGAL_INT, NULL);
 }
 
 
@@ -381,37 +562,25 @@ void sig_ints_init(void)
     new_act.sa_sigaction = sighandler;
     new_act.sa_flags = SA_SIGINFO;
     /*
-     * We want to contine to receive SIGSEGV signals, even in a signal
-     * handler, so don't defer them. The other signals are in the sa_mask
-     * so they will be blocked.
+     * Nothing is blocked while the handler runs. It often switches to
+     * another context before it returns, and that context must go on
+     * receiving signals; the PSR and int_off() keep out the ones that
+     * should wait.
      */
     new_act.sa_flags |= SA_NODEFER;
     err_return = sigemptyset(&new_act.sa_mask);
     usloss_sys_assert(err_return != -1, "error creating empty  signal set");
-    err_return = sigaddset(&new_act.sa_mask, SIG_ALARM);
-    usloss_sys_assert(err_return != -1, "error adding SIG_ALARM to set");
-    err_return = sigaddset(&new_act.sa_mask, SIGUSR1);
-    usloss_sys_assert(err_return != -1, "error adding SIGUSR1 to set");
 
     err_return = sigaction(SIG_ALARM, &new_act, &old_actions[SIG_ALARM]);
     usloss_sys_assert(err_return != -1, "error setting up SIG_ALARM action");
-    err_return = sigaction(SIGUSR1, &new_act, &old_actions[SIGUSR1]);
-    usloss_sys_assert(err_return != -1, "error setting up SIGUSR1 action");
 #ifdef MMU
     err_return = sigaction(SIGSEGV, &new_act, &old_actions[SIGSEGV]);
     usloss_sys_assert(err_return != -1, "error setting up SIGSEGV action");
     err_return = sigaction(SIGBUS, &new_act, &old_actions[SIGBUS]);
     usloss_sys_assert(err_return != -1, "error setting up SIGBUS action");
 #endif
-    /*  Set up the timer_set (used for enabling and disabling interrupts) and
-        disable those interrupts */
-    err_return = sigemptyset(&timer_set);
-    usloss_sys_assert(err_return != -1, "error creating empty timer set");
-    err_return = sigaddset(&timer_set, SIG_ALARM);
-    usloss_sys_assert(err_return != -1, "error adding SIG_ALARM to timer set");
-    err_return = sigaddset(&timer_set, SIGUSR1);
-    usloss_sys_assert(err_return != -1, "error adding SIGUSR1 to timer set");
-    (void) int_off();
+    /*  The PSR starts with interrupts off, which holds them until the
+        startup code turns them on */
     set_timer();
 }
 
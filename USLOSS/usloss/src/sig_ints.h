@@ -8,6 +8,17 @@ dynamic_dcl void set_timer(void);
 dynamic_dcl void sig_ints_init(void);
 dynamic_dcl int int_off(void);
 dynamic_dcl void int_on(void);
+dynamic_dcl void take_pending(void);
+
+/*  Events charged to the clock in deterministic time */
+#define COST_CALL	0
+#define COST_SYSCALL	1
+#define COST_SWITCH	2
+#define COST_DEVICE	3
+#define COST_NUM	4
+
+dynamic_dcl int cost_set(char *list);
+dynamic_dcl void charge(int event);
 
 #endif	/*  _sig_ints_h */
 
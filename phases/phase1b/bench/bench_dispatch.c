@@ -0,0 +1,85 @@
+/*
+ * Dispatch microbenchmark.
+ *
+ * N "filler" processes share one priority and take turns waking a
+ * higher-priority partner, which immediately blocks again.  Every round
+ * therefore costs one unblockProc(), two context switches, and one
+ * requeue of the filler at the tail of a run queue holding N processes.
+ * If enqueue/dequeue/pick-next are O(1), the cost per round stays flat
+ * as N grows.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define ROUNDS 20000
+
+int Partner(void *);
+int Filler (void *);
+
+static int partner_pid;
+static int rounds_left;
+static int done;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void run_round(int nfillers)
+{
+    int status;
+
+    done        = 0;
+    rounds_left = ROUNDS;
+
+    // the partner runs first (priority 1) and parks itself in blockMe()
+    partner_pid = spork("Partner", Partner, NULL, USLOSS_MIN_STACK, 1);
+
+    // fillers are lower priority than testcase_main, so none run yet
+    for (int i = 0; i < nfillers; i++)
+        spork("Filler", Filler, NULL, USLOSS_MIN_STACK, 4);
+
+    long long start = now_ns();
+    for (int i = 0; i < nfillers; i++)
+        join(&status);
+    long long elapsed = now_ns() - start;
+
+    done = 1;
+    unblockProc(partner_pid);
+    join(&status);
+
+    USLOSS_Console("bench_dispatch: runnable=%4d  rounds=%d  ns/round=%lld\n",
+                   nfillers, ROUNDS, elapsed / ROUNDS);
+}
+
+int testcase_main()
+{
+    int sizes[] = { 1, 2, 4, 8, 16, 32, 64, 256, 1024, 4096 };
+
+    // leave room for init, testcase_main, and the partner
+    setMaxProcs(4096 + 3);
+
+    for (int i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++)
+        run_round(sizes[i]);
+
+    return 0;
+}
+
+int Partner(void *arg)
+{
+    while (!done)
+        blockMe();
+    return 0;
+}
+
+int Filler(void *arg)
+{
+    while (rounds_left-- > 0)
+        unblockProc(partner_pid);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Interrupts-off microbenchmark.
+ *
+ * Reports the longest stretch that phase 1 keeps interrupts disabled --
+ * which bounds how late an interrupt can be taken -- on the kernel paths
+ * whose length depends on their input:
+ *
+ *   - waitQueueWakeAll() on a queue of N sleepers
+ *   - unblockProcs() on N blocked processes
+ *   - dumpProcesses() with N processes
+ *   - spork() when the stack pool has nothing of the right size
+ *
+ * The calls are made by a driver at priority 1, above the sleepers, so a
+ * wake call returns before any of them runs and the figure is the call's
+ * own.  Each size runs REPS times, and the worst of them is reported.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define REPS 10
+#define MAXN 4000
+
+static WaitQueue wq;
+static int       pids[MAXN];
+static int       n;
+
+int Driver(void *);
+int Sleeper(void *);
+int Blocker(void *);
+int Quitter(void *);
+
+static IrqsOffStats worst;
+
+static void start(void)
+{
+    resetIrqsOffStats();
+}
+
+static void stop(void)
+{
+    IrqsOffStats stats;
+
+    getIrqsOffStats(&stats);
+    if (stats.max_ns > worst.max_ns)
+        worst = stats;
+}
+
+static void report(char *path)
+{
+    USLOSS_Console("bench_irqsoff: %-16s n=%4d  max_us=%8.1f  in %s\n",
+                   path, n, worst.max_ns / 1000.0, worst.max_where ? worst.max_where : "-");
+    memset(&worst, 0, sizeof(worst));
+}
+
+static void run(char *path, int (*sleeper)(void *), int which)
+{
+    int status;
+
+    for (int r = 0; r < REPS; r++) {
+        for (int i = 0; i < n; i++)
+            pids[i] = spork(path, sleeper, NULL, USLOSS_MIN_STACK, 2);
+
+        spork("Driver", Driver, (void *)(long)which, USLOSS_MIN_STACK, 1);
+        join(&status);
+
+        for (int i = 0; i < n; i++)
+            join(&status);
+    }
+    report(path);
+}
+
+int testcase_main()
+{
+    int sizes[] = { 16, 256, 1024, MAXN };
+
+    setMaxProcs(MAXN + 10);
+
+    for (int i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++) {
+        n = sizes[i];
+        run("waitQueueWakeAll", Sleeper, 0);
+        run("unblockProcs",     Blocker, 1);
+        run("dumpProcesses",    Blocker, 2);
+    }
+
+    // a stack size of its own each time, so every spork() maps a new stack
+    n = 1;
+    for (int r = 0; r < REPS; r++) {
+        int status;
+        start();
+        spork("Quitter", Quitter, NULL, 64 * USLOSS_MIN_STACK + 4096 * (r + 1), 4);
+        stop();
+        join(&status);
+    }
+    report("spork (new stack)");
+
+    return 0;
+}
+
+int Driver(void *arg)
+{
+    switch ((int)(long)arg) {
+    case 0:
+        start();
+        waitQueueWakeAll(&wq, 0);
+        stop();
+        break;
+    case 1:
+        start();
+        unblockProcs(pids, n);
+        stop();
+        break;
+    case 2:
+        // the dump goes nowhere; the point is the time spent on it
+        start();
+        dumpProcesses();
+        stop();
+        unblockProcs(pids, n);
+        break;
+    }
+    return 0;
+}
+
+int Sleeper(void *arg)
+{
+    waitQueueSleep(&wq, NULL);
+    return 0;
+}
+
+int Blocker(void *arg)
+{
+    blockMe();
+    return 0;
+}
+
+int Quitter(void *arg)
+{
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * Worker pool microbenchmark.
+ *
+ * Runs TASKS trivial tasks, BATCH at a time, two ways: a spork() and a
+ * join() per task, and a poolSubmit() and a poolCollect() per task on a
+ * pool of BATCH workers.  The workers run at the same priority as the
+ * sporked children, so in both cases each task runs as soon as it has a
+ * process to run on.  The pool is created (and destroyed) outside the
+ * timed region, since a server would keep it for its whole life.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define TASKS 100000
+
+int Task(void *);
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(char *how, int batch, long long elapsed)
+{
+    USLOSS_Console("bench_pool: %-10s batch=%2d  tasks/sec=%9lld  ns/task=%6lld\n",
+                   how, batch, TASKS * 1000000000LL / elapsed, elapsed / TASKS);
+}
+
+static void run_spork(int batch)
+{
+    int status;
+
+    long long start = now_ns();
+    for (int done = 0; done < TASKS; done += batch) {
+        for (int i = 0; i < batch; i++)
+            spork("Task", Task, NULL, USLOSS_MIN_STACK, 2);
+        for (int i = 0; i < batch; i++)
+            join(&status);
+    }
+    report("spork/join", batch, now_ns() - start);
+}
+
+static void run_pool(int batch)
+{
+    int result;
+
+    WorkerPool *pool = poolCreate("Worker", batch, USLOSS_MIN_STACK, 2);
+
+    long long start = now_ns();
+    for (int done = 0; done < TASKS; done += batch) {
+        for (int i = 0; i < batch; i++)
+            poolSubmit(pool, Task, NULL);
+        for (int i = 0; i < batch; i++)
+            poolCollect(pool, &result);
+    }
+    report("pool", batch, now_ns() - start);
+
+    poolDestroy(pool);
+}
+
+int testcase_main()
+{
+    int batches[] = { 1, 4, 16, 40 };
+
+    for (int i = 0; i < (int)(sizeof(batches)/sizeof(batches[0])); i++) {
+        run_spork(batches[i]);
+        run_pool(batches[i]);
+    }
+
+    return 0;
+}
+
+int Task(void *arg)
+{
+    return 0;
+}
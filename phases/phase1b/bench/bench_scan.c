@@ -0,0 +1,94 @@
+/*
+ * Process table scan microbenchmark.
+ *
+ * This is a white-box benchmark: it includes phase1b.c itself so that it
+ * can walk the process table the way the kernel does (through the pid
+ * map, reading each pcb's scheduling state, as the MLFQ boost does).  It
+ * fills the table with N blocked processes, then times those scans.  It
+ * also times a wakeup + two context switches with the table full, like
+ * bench_dispatch.
+ */
+
+#include <time.h>
+#include "../phase1b.c"
+
+#define NPROCS  10000
+#define PASSES  200
+#define ROUNDS  20000
+
+int Sleeper(void *);
+int Partner(void *);
+
+static int partner_pid;
+static int done;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// visit every process, reading the state a scheduler or accounting scan would
+static long scan_table(void)
+{
+    long sum = 0;
+    for (int i = 0; i < pid_map_size; i++) {
+        pcb *proc = pid_map[i];
+        if (proc && proc->is_alive && !proc->termination && proc->is_blocked)
+            sum += proc->priority + proc->sched_level;
+    }
+    return sum;
+}
+
+int testcase_main()
+{
+    static int pids[NPROCS];
+    int status;
+
+    // leave room for init, testcase_main, and the partner
+    setMaxProcs(NPROCS + 3);
+
+    // sleepers are higher priority than testcase_main, so each one runs and blocks right away
+    for (int i = 0; i < NPROCS; i++)
+        pids[i] = spork("Sleeper", Sleeper, NULL, USLOSS_MIN_STACK, 2);
+
+    long sum   = 0;
+    long long start = now_ns();
+    for (int i = 0; i < PASSES; i++)
+        sum += scan_table();
+    long long scan = (now_ns() - start) / PASSES;
+
+    // time wakeup + two context switches with the table full
+    partner_pid = spork("Partner", Partner, NULL, USLOSS_MIN_STACK, 1);
+    start = now_ns();
+    for (int i = 0; i < ROUNDS; i++)
+        unblockProc(partner_pid);
+    long long dispatch = (now_ns() - start) / ROUNDS;
+
+    USLOSS_Console("bench_scan: sizeof(pcb)=%d  procs=%d  ns/scan=%lld  ns/pcb=%lld.%02lld  ns/round=%lld  (%ld)\n",
+                   (int)sizeof(pcb), NPROCS, scan, scan / NPROCS, scan * 100 / NPROCS % 100, dispatch,
+                   sum / PASSES);
+
+    done = 1;
+    unblockProc(partner_pid);
+    join(&status);
+    unblockProcs(pids, NPROCS);
+    for (int i = 0; i < NPROCS; i++)
+        join(&status);
+
+    return 0;
+}
+
+int Sleeper(void *arg)
+{
+    blockMe();
+    return 0;
+}
+
+int Partner(void *arg)
+{
+    while (!done)
+        blockMe();
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Context switch microbenchmark.
+ *
+ * Two figures:
+ *
+ *   - raw: testcase_main and a bare USLOSS context bounce back and forth
+ *     through USLOSS_ContextSwitch() with interrupts off, so each round is
+ *     exactly two switches and nothing else.
+ *   - process: two phase 1 processes take turns waking each other with
+ *     unblockProc() and going to sleep with blockMe(), so each round is two
+ *     switches plus the dispatcher around them.
+ *
+ * Run it twice to compare the two ways USLOSS can switch:
+ *
+ *     ./bench_switch          fast path (callee-saved registers only)
+ *     ./bench_switch -s       swapcontext(), which also saves the signal mask
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define RAW_ROUNDS  1000000
+#define PROC_ROUNDS 200000
+
+int Pong(void *);
+
+static USLOSS_Context main_ctx, ping_ctx;
+static char           ping_stack[USLOSS_MIN_STACK];
+
+static int pong_pid;
+static int rounds_left;
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void ping(void)
+{
+    for (;;)
+        USLOSS_ContextSwitch(&ping_ctx, &main_ctx);
+}
+
+static void report(char *what, int rounds, long long elapsed)
+{
+    USLOSS_Console("bench_switch: %-8s rounds=%7d  ns/switch=%5lld  switches/s=%lld\n",
+                   what, rounds, elapsed / (2LL * rounds),
+                   2LL * rounds * 1000000000LL / elapsed);
+}
+
+int testcase_main()
+{
+    unsigned int psr = USLOSS_PsrGet();
+    int status;
+
+    if (USLOSS_PsrSet(psr & ~USLOSS_PSR_CURRENT_INT) != USLOSS_ERR_OK)
+        USLOSS_Halt(1);
+    USLOSS_ContextInit(&ping_ctx, ping_stack, sizeof(ping_stack), NULL, ping);
+
+    long long start = now_ns();
+    for (int i = 0; i < RAW_ROUNDS; i++)
+        USLOSS_ContextSwitch(&main_ctx, &ping_ctx);
+    report("raw", RAW_ROUNDS, now_ns() - start);
+
+    if (USLOSS_PsrSet(psr) != USLOSS_ERR_OK)
+        USLOSS_Halt(1);
+
+    // Pong is above testcase_main, so it runs at once and parks in blockMe()
+    rounds_left = PROC_ROUNDS;
+    pong_pid    = spork("Pong", Pong, NULL, USLOSS_MIN_STACK, 2);
+
+    start = now_ns();
+    while (rounds_left > 0)
+        unblockProc(pong_pid);
+    report("process", PROC_ROUNDS, now_ns() - start);
+
+    join(&status);
+    return 0;
+}
+
+int Pong(void *arg)
+{
+    blockMe();
+    while (--rounds_left > 0)
+        blockMe();
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Bulk zap microbenchmark.
+ *
+ * Starts N children below testcase_main's priority, then tears them down
+ * two ways: a zap() per child, and one zapMany() for all of them.  Each
+ * zap() blocks testcase_main until its child has run and quit, so the
+ * serial teardown switches back to testcase_main after every child; the
+ * bulk one switches back once.  The joins are timed too.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define MAXN 2000
+#define REPS 20
+
+static int pids[MAXN];
+
+int Child(void *);
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void run(int n, int bulk)
+{
+    long long elapsed = 0;
+    int status;
+
+    for (int r = 0; r < REPS; r++) {
+        for (int i = 0; i < n; i++)
+            pids[i] = spork("Child", Child, NULL, USLOSS_MIN_STACK, 4);
+
+        long long start = now_ns();
+        if (bulk) {
+            zapMany(pids, n);
+        } else {
+            for (int i = 0; i < n; i++)
+                zap(pids[i]);
+        }
+        for (int i = 0; i < n; i++)
+            join(&status);
+        elapsed += now_ns() - start;
+    }
+
+    USLOSS_Console("bench_zap: %-8s n=%4d  ns/child=%6lld\n",
+                   bulk ? "zapMany" : "zap", n, elapsed / REPS / n);
+}
+
+int testcase_main()
+{
+    int sizes[] = { 10, 100, 1000, MAXN };
+
+    setMaxProcs(MAXN + 10);
+
+    for (int i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); i++) {
+        run(sizes[i], 0);
+        run(sizes[i], 1);
+    }
+
+    return 0;
+}
+
+int Child(void *arg)
+{
+    return 0;
+}
@@ -1,86 +1,382 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
 #include "phase1.h"
 
 
+// what a process has used, for getProcInfo()
+typedef struct proc_acct {
+           long long       cpu_us;        // charged when it is switched away from
+           long            vol_switches;  // switched away from because it blocked or quit
+           long            invol_switches;// switched away from while still runnable
+           long            syscalls;      // counted by the syscall handler
+           long            io_bytes[ACCT_KINDS]; // counted by the device drivers
+} proc_acct;
+
+// the parts of a process that are only touched when it is created, switched to, or reaped
+// (or, for the accounting, when it uses something)
+// kept apart from the pcb so that scans of the process table don't drag them through the cache
+typedef struct pcb_cold {
+           USLOSS_Context context;        // saved registers and signal mask, about 1KB
+           char           *name;          // useful for debug
+           int           (*func)(void *);
+           void           *arg;
+           char           *stack;
+           int             stack_size;    // usable bytes at stack, as mapped by stack_alloc
+           proc_acct       acct;          // cleared when the slot is handed out
+} pcb_cold;
+
+// one zapper waiting for one target to quit, linked into the target's zap list
+// it belongs to the zapper, which keeps it until it wakes up
+typedef struct zap_wait {
+    struct zap_wait      *next;
+    struct pcb           *zapper;
+} zap_wait;
+
 // Process Control Block struct
-typedef struct pcb {
+// PCBs are cache-line aligned, and the first line holds what the dispatcher and the run queues touch
+// on every pass (checked below); the rest of the scheduling state, the family and wait queue links,
+// and the other phases' per-process data follow
+typedef struct __attribute__((aligned(64))) pcb {
 
-    struct pcb           *parent;         // parent process
-    struct pcb           *first_child; 
-    struct pcb           *next_sibling;
+    // scheduling state, hot
     struct pcb           *next_run;       // run queue
-    struct pcb           *first_zap;      // head of zap
-    struct pcb           *next_zap;
-
+    struct pcb           *prev_run;
+           long long      sched_pass;     // stride pass value
            int            pid;
            int            priority;
+           int            queue_num;      // run queue it is linked into, while on_runq
+           int            heap_index;     // position in the stride heap, while on_runq
+           int            runq_since;     // when it became runnable, for the run queue wait stats
+           int            age_since;      // when it last moved up a queue (or became runnable), for aging
+           int            sched_level;    // MLFQ level, starts at priority-1
+           int            sched_used;     // us of CPU used at the current MLFQ level
+           int            sched_epoch;    // MLFQ boost its level is current for
+           unsigned char  on_runq;        // 1 if the scheduler has it as runnable
+           unsigned char  is_blocked;     // flag for blocking
+           unsigned char  termination;    // flag for quit
+           unsigned char  trace_woken;    // made runnable by a wakeup, and not run since
+
+    // scheduling state, touched off the dispatch path
+    struct pcb           *next_demoted;   // MLFQ list of runnable processes below their priority's level
+    struct pcb           *prev_demoted;
            int            status;         // filled in quit
-           int            is_alive;       // 1 if alive, 0 if dead (usable)
-           int            termination;    // flag for quit
-           int            is_blocked;     // flag for blocking
-           int            in_join;        // flag for blocking in join
-           int            in_zap;         // flag for blocking in zap
-                  
-           USLOSS_Context context;
-        
-           char           *name;          // useful for debug
-           int           (*func)(void *);
-           void           *arg;
-           char           *stack;
+           int            slot;           // index in the process table arena (never changes)
+           unsigned char  is_alive;       // 1 if alive, 0 if dead (usable)
+           unsigned char  in_join;        // flag for blocking in join
+           unsigned char  in_zap;         // flag for blocking in zap
+
+    // family
+    struct pcb           *parent;         // parent process
+    struct pcb           *first_child; 
+    struct pcb           *next_sibling;
+    struct pcb           *prev_sibling;
+    struct pcb           *first_zombie;   // terminated children, newest (highest pid) first
+    struct pcb           *last_zombie;
+    struct pcb           *next_zombie;    // zombie list of the parent
+    struct pcb           *prev_zombie;
+    struct pcb           *join_target;    // the child joinPid() is waiting on, if any
+    zap_wait             *first_zap;      // zappers waiting for this process to quit
+           int            zap_pending;    // targets of our zap call that have not quit yet
+
+    // wait queue
+    struct pcb           *next_wait;      // the wait queue it was added to by waitQueueAdd()
+    void                 *wait_data;      // for waitQueuePeek()
+           int            wait_value;     // passed by the wake call, returned by waitQueueBlock()
+           unsigned char  wait_state;     // WAIT_NONE, WAIT_QUEUED, or WAIT_WOKEN
+           unsigned char  in_wait;        // flag for blocking in waitQueueBlock
+
+    // storage handed out by procDataRegister()
+           char           data[PROC_DATA_SIZE] __attribute__((aligned(8)));
+
+           pcb_cold      *cold;           // this slot's entry in the cold arena (never changes)
     
 } pcb;
 
+_Static_assert(offsetof(pcb, trace_woken) < 64, "the hot scheduling state of a PCB no longer fits in one cache line");
+
+// a task submitted to a worker pool
+typedef struct pool_task {
+    struct pool_task  *next;          // pending, done, or free list of the pool
+           int       (*func)(void *);
+           void       *arg;
+           int         ticket;
+           int         result;
+} pool_task;
+
+struct WorkerPool {
+    pool_task *pending_head;          // submitted, waiting for a worker
+    pool_task *pending_tail;
+    pool_task *done_head;             // finished, waiting for poolCollect()
+    pool_task *done_tail;
+    pool_task *free_tasks;            // task structs to reuse
+    WaitQueue  idle;                  // workers with nothing to do
+    WaitQueue  collectors;            // processes in poolCollect()
+    int       *pids;                  // the workers
+    int        nworkers;
+    int        next_ticket;
+    int        outstanding;           // submitted and not yet collected
+    int        closing;               // set by poolDestroy(); idle workers quit
+};
+
+struct WorkQueue {
+    WorkItem  *head;                  // queued, not started yet, linked through next
+    WorkItem  *tail;
+    WaitQueue  idle;                  // workers with nothing to do
+    WaitQueue  flushers;              // processes in workQueueFlush()
+    int       *pids;                  // the workers
+    int        nworkers;
+    int        busy;                  // workers running an item
+    int        closing;               // set by workQueueDestroy(); workers quit once the queue is empty
+};
+
+// a run queue, linked through next_run/prev_run
+typedef struct run_queue {
+    pcb *head;
+    pcb *tail;
+} run_queue;
+
+// a scheduling policy -- the dispatcher only talks to the run queue through one of these
+typedef struct sched_ops {
+    const char  *name;
+    void       (*init)       (void);                 // start with nothing runnable
+    void       (*enqueue)    (pcb *proc);            // proc has become runnable
+    void       (*dequeue)    (pcb *proc);            // proc is no longer runnable
+    pcb *      (*pick_next)  (void);                 // best runnable process (left queued), or NULL
+    void       (*tick)       (pcb *proc, int used);  // charge proc for used us of CPU
+    int        (*quantum_for)(pcb *proc);            // ms proc may run before its peers get a turn
+} sched_ops;
+
 
 
 /*
  * function stubs
  */
 
-int          scan_table           (      int          toCheck     );
-int          get_next_pid         (                               );
-pcb*         get_proc             (      int          pid         );
-void         check_kernel_mode    (const char        *func        );
-void         enable_interrupts    (                               );
-unsigned int disable_interrupts   (                               );
-void         restore_interrupts   (      unsigned int old_psr     );
-unsigned int check_and_disable    (const char        *func        );
-void         phase1_init          (      void                     );
-void         init_main            (      void                     );
-int          testcase_main_wrapper(                               );
-int          spork                (      char        *name         ,
-                                         int        (*func)(void *),
-                                         void        *arg          ,
-                                         int          stacksize    , 
-                                         int          priority    );
-void         funcWrapper          (                               );
-int          join                 (      int         *status      );
-void         quit                 (      int          status      );
-void         zap                  (      int          pid         );
-void         enqueue_proc         (      int          pid         );
-void         dequeue_proc         (                               ); 
-void         blockMe              (                               );
-int          unblockProc          (      int          pid         );
-void         dispatcher           (                               );
-int          getpid               (                               );
-void         dumpQueues           (                               );
-void         dumpChildren         (                               );
-void         dumpProcesses        (                               );
+static int          pid_find_free        (      int          start       );
+static void         pid_claim            (      pcb         *proc         ,
+                                                int          pid         );
+static void         pid_release          (      pcb         *proc        );
+static int          pid_map_grow         (                               );
+static char*        stack_alloc          (      int          stacksize    ,
+                                                int         *mapped_size  ,
+                                                unsigned int old_psr     );
+static void         stack_free           (      char        *stack        ,
+                                                int          size        );
+       void         getStackPoolStats    (      StackPoolStats *stats    );
+static pcb*         pcb_alloc            (                               );
+static void         pcb_free             (      pcb         *proc        );
+static int          get_next_pid         (                               );
+static pcb*         get_proc             (      int          pid         );
+static void         check_kernel_mode    (const char        *func        );
+static void         enable_interrupts    (                               );
+static unsigned int disable_interrupts   (                               );
+static void         restore_interrupts   (      unsigned int old_psr     );
+static unsigned int check_and_disable    (const char        *func        );
+       unsigned int criticalEnter        (const char        *func        );
+       void         criticalExit         (      unsigned int old_psr     );
+static long long    irqsoff_clock_ns     (                               );
+static void         irqsoff_begin        (const char        *func        );
+static void         irqsoff_end          (                               );
+       void         getIrqsOffStats      (      IrqsOffStats *stats      );
+       void         resetIrqsOffStats    (                               );
+       void         phase1_init          (      void                     );
+       int          setMaxProcs          (      int          max         );
+       int          procSlot             (      int          pid         );
+       int          procDataRegister     (      int          size        );
+       int          setQuantum           (      int          ms          );
+       int          setAging             (      int          ms          );
+       int          getMaxRunqWait       (      int          priority    );
+static void         env_ms               (const char        *name         ,
+                                                int        (*set)(int)   );
+       void*        procData             (      int          key         );
+static void         init_main            (      void                     );
+static int          testcase_main_wrapper(                               );
+       int          spork                (      char        *name         ,
+                                                int        (*func)(void *),
+                                                void        *arg          ,
+                                                int          stacksize    , 
+                                                int          priority    );
+static void         funcWrapper          (                               );
+       int          join                 (      int         *status      );
+       int          joinPid              (      int          pid          ,
+                                                int         *status      );
+static int          reap_child           (      pcb         *child        ,
+                                                int         *status      );
+       void         quit                 (      int          status      );
+static pcb*         zap_check            (      int          pid         );
+static void         zap_add              (      pcb         *target       ,
+                                                zap_wait    *wait        );
+static void         zap_block            (                               );
+static pcb*         tree_next            (      pcb         *proc         ,
+                                                pcb         *root        );
+       void         zap                  (      int          pid         );
+       void         zapMany              (      int         *pids         ,
+                                                int          n           );
+       int          zapTree              (      int          pid         );
+static void         enqueue_proc         (      int          pid         );
+static void         dequeue_proc         (                               ); 
+static void         runq_add             (      pcb         *proc        );
+static void         runq_remove          (      pcb         *proc        );
+static pcb*         runq_pick            (                               );
+       int          setScheduler         (const char        *name        );
+       void         blockMe              (                               );
+static void         block_cur            (                               );
+       int          unblockProc          (      int          pid         );
+       int          unblockProcs         (      int         *pids         ,
+                                                int          n           );
+static int          wake_proc            (      pcb         *proc        );
+static void         wake_dispatch        (                               );
+       void         preemptDisable       (                               );
+       void         preemptEnable        (                               );
+       void         interruptEnter       (                               );
+       void         interruptExit        (                               );
+       void         requestResched       (                               );
+       void         reschedIfNeeded      (                               );
+static int          wake_batched         (      pcb         *proc        );
+static void         wake_batch_end       (      int          unblocked   );
+static int          trace_event          (      int          type         ,
+                                                pcb         *proc        );
+static void         trace_put            (      int          type         ,
+                                                pcb         *proc         ,
+                                                int          time        );
+static void         trace_dispatch       (      pcb         *proc         ,
+                                                int          now         );
+static void         acct_charge          (      int          now         );
+       void         accountSyscall       (                               );
+       void         accountIO            (      int          kind         ,
+                                                int          bytes       );
+       int          getProcInfo          (      int          pid          ,
+                                                ProcInfo    *info        );
+static int          cmp_cpu              (const void        *a            ,
+                                          const void        *b           );
+       void         dumpTop              (                               );
+static pcb*         wait_pop             (      WaitQueue   *wq           ,
+                                                int          value       );
+static void         wait_add             (      WaitQueue   *wq           ,
+                                                void        *data        );
+static int          wait_block           (                               );
+static int          wait_wake            (      WaitQueue   *wq           ,
+                                                int          value       );
+       void         waitQueueInit        (      WaitQueue   *wq          );
+       void         waitQueueAdd         (      WaitQueue   *wq           ,
+                                                void        *data        );
+       int          waitQueueBlock       (                               );
+       int          waitQueueSleep       (      WaitQueue   *wq           ,
+                                                void        *data        );
+       void*        waitQueuePeek        (      WaitQueue   *wq          );
+       void         waitQueueSplice      (      WaitQueue   *dst          ,
+                                                WaitQueue   *src         );
+       int          waitQueueWakeOne     (      WaitQueue   *wq          );
+       int          waitQueueWakeValue   (      WaitQueue   *wq           ,
+                                                int          value       );
+       int          waitQueueWakeAll     (      WaitQueue   *wq           ,
+                                                int          value       );
+       WorkerPool*  poolCreate           (      char        *name         ,
+                                                int          nworkers     ,
+                                                int          stacksize    ,
+                                                int          priority    );
+static int          pool_worker          (      void        *arg         );
+static void         pool_close           (      WorkerPool  *pool         ,
+                                                int          nworkers    );
+       int          poolSubmit           (      WorkerPool  *pool         ,
+                                                int        (*func)(void *),
+                                                void        *arg         );
+       int          poolCollect          (      WorkerPool  *pool         ,
+                                                int         *result      );
+       int          poolDestroy          (      WorkerPool  *pool        );
+       void         workInit             (      WorkItem    *work         ,
+                                                void       (*func)(void *),
+                                                void        *arg         );
+       WorkQueue*   workQueueCreate      (      char        *name         ,
+                                                int          nworkers     ,
+                                                int          stacksize    ,
+                                                int          priority    );
+static int          work_worker          (      void        *arg         );
+static void         work_close           (      WorkQueue   *wq           ,
+                                                int          nworkers    );
+       int          queueWork            (      WorkQueue   *wq           ,
+                                                WorkItem    *work        );
+       void         workQueueFlush       (      WorkQueue   *wq          );
+       int          workQueueDestroy     (      WorkQueue   *wq          );
+       void         dispatcher           (                               );
+       int          getpid               (                               );
+       int          currentTime          (                               );
+       void         dumpQueues           (                               );
+       void         dumpChildren         (                               );
+       void         dumpProcesses        (                               );
 
 
 /*
  * global variables
  */
 
-pcb   proc_table[MAXPROC];          // the process table
-pcb*  cur_proc = &proc_table[0];    // a reference to the current process
-char  init_stack[USLOSS_MIN_STACK]; // the stack for the init process
-int   last_pid_created;             // the pid of the last process that was created in spork
-
-// array of run-queue heads
-pcb *queues[6];
-int time_ofLastSwitch = 0;          // the system time of the last context switch
+static pcb_cold boot_cold;
+static pcb   boot_proc = { .cold = &boot_cold }; // stands in for the current process before the first dispatch
+static pcb*  cur_proc = &boot_proc;          // a reference to the current process
+static char  init_stack[USLOSS_MIN_STACK];   // the stack for the init process
+static int   last_pid_created;               // the pid of the last process that was created in spork
+
+// the process table is an arena of MAXPROC-sized chunks, allocated on demand
+// PCBs never move, so a pcb pointer stays valid for the life of its process
+// each chunk of PCBs has a matching chunk of pcb_cold
+static pcb      first_chunk[MAXPROC];        // chunk 0, the only one touched at boot
+static pcb_cold first_cold_chunk[MAXPROC];
+static pcb **proc_chunks;                    // proc_chunks[i] is chunk i
+static int   num_chunks;
+static pcb  *free_pcbs;                      // unused PCBs, linked through next_run
+static int   num_procs;                      // live (or unjoined) processes
+static int   max_procs = MAXPROC;            // limit on num_procs, see setMaxProcs()
+static int   proc_data_used;                 // bytes of pcb.data reserved by procDataRegister()
+
+// pid_map[pid % pid_map_size] is the process with that pid, or NULL
+// free_pids has bit i set iff pid_map[i] is NULL
+// the map doubles whenever it fills up and max_procs allows more processes
+static pcb                *first_pid_map[MAXPROC];
+static unsigned long long  first_free_pids[(MAXPROC + 63) / 64];
+static pcb               **pid_map       = first_pid_map;
+static unsigned long long *free_pids     = first_free_pids;
+static int                 pid_map_size  = MAXPROC;
+#define PID_WORDS ((pid_map_size + 63) / 64)
+
+// process stacks are mmap'd with a PROT_NONE guard page below them, and
+// kept in per-size-class free lists after join() so spork() can reuse them
+// class i holds stacks of USLOSS_MIN_STACK << i bytes; larger stacks are never cached
+#define STACK_CLASSES        8
+#define STACK_POOL_MAX_BYTES (64 * 1024 * 1024)   // stop caching past this many bytes
+
+typedef struct free_stack {
+    struct free_stack *next;                  // stored in the cached stack itself
+} free_stack;
+
+static free_stack     *stack_pool[STACK_CLASSES];
+static StackPoolStats  stack_stats;
+
+// array of run queues, and a bitmap with bit i set iff queues[i] is non-empty
+// the priority and MLFQ policies keep their runnable processes here
+static run_queue    queues[6];
+static unsigned int queue_bitmap;
+
+static const sched_ops  sched_priority;     // the default policy, defined with the others below
+static const sched_ops *sched = &sched_priority;  // the current scheduling policy
+static int              time_ofLastCharge;  // the system time cur_proc was last charged for its CPU
+static int              prio_quantum = 80;  // ms, see setQuantum()
+static int              aging_ms = 1000;    // ms on a run queue before moving up one, or 0; see setAging()
+static int              max_runq_wait[7];   // by priority, the longest us a process waited to run
+static int              tracing;            // set between traceStart() and traceStop()
+static int              need_resched;       // a wakeup made a process runnable that should preempt cur_proc
+static int              preempt_count;      // wakeups don't switch processes while nonzero, see preemptDisable()
+static int              irqsoff_timing;     // set by the first resetIrqsOffStats(); until then nothing is timed
+static long long        irqsoff_start;      // when interrupts went off, in host ns, or 0 if they are on
+static const char      *irqsoff_where;      // the function that turned them off
+static IrqsOffStats     irqsoff_stats;
+static int              cur_requeued;       // set by wake_batched() if it already put cur_proc behind its peers
+static int          time_ofLastSwitch = 0;  // the system time of the last context switch
+static int          time_ofLastRun = 0;     // when cur_proc last started using the CPU, for its accounting
 
 
 /*
@@ -88,36 +384,229 @@ int time_ofLastSwitch = 0;          // the system time of the last context switc
  */
 
 
-// Scan the proc table to verify the presence of an arg pid
-int scan_table(int toCheck) {
-    //iterate over each item in the table 
-    for (int i = 0; i < MAXPROC; i++) {
-        if (proc_table[i].pid == toCheck) {return 1;}
+// a pid maps to pid_map[pid % pid_map_size].  each map entry only ever
+// receives increasing pids, so a stale pid can never alias the entry's new
+// owner, and validating a pid is one indexed compare.  doubling the map
+// keeps live pids distinct, since a % 2n == b % 2n implies a % n == b % n
+
+// return the first free pid map entry at or after start, wrapping around
+// returns -1 if every entry is in use
+static int pid_find_free(int start) {
+    for (int n = 0; n <= PID_WORDS; n++) {
+        int                w    = (start / 64 + n) % PID_WORDS;
+        unsigned long long bits = free_pids[w];
+
+        // on the first word, ignore the entries before start
+        if (n == 0) bits &= ~0ULL << (start % 64);
+        if (bits) return w * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+// record that a process now owns the given pid
+static void pid_claim(pcb *proc, int pid) {
+    int idx = pid % pid_map_size;
+    pid_map[idx] = proc;
+    free_pids[idx / 64] &= ~(1ULL << (idx % 64));
+    proc->pid = pid;
+}
+
+// give a process's pid back to the map
+static void pid_release(pcb *proc) {
+    int idx = proc->pid % pid_map_size;
+    pid_map[idx] = NULL;
+    free_pids[idx / 64] |= 1ULL << (idx % 64);
+}
+
+// double the size of the pid map, rehashing the live pids into it
+// returns -1 if the memory could not be allocated
+static int pid_map_grow() {
+    int                 new_size  = pid_map_size * 2;
+    pcb               **new_map   = calloc(new_size, sizeof(pcb *));
+    unsigned long long *new_free  = malloc(((new_size + 63) / 64) * sizeof(unsigned long long));
+    if (!new_map || !new_free) {
+        free(new_map);
+        free(new_free);
+        return -1;
+    }
+
+    // every entry starts free; entries past new_size never get set
+    memset(new_free, 0, ((new_size + 63) / 64) * sizeof(unsigned long long));
+    for (int i = 0; i < new_size; i++) new_free[i / 64] |= 1ULL << (i % 64);
+
+    pcb               **old_map  = pid_map;
+    unsigned long long *old_free = free_pids;
+    int                 old_size = pid_map_size;
+
+    pid_map      = new_map;
+    free_pids    = new_free;
+    pid_map_size = new_size;
+    for (int i = 0; i < old_size; i++) {
+        if (old_map[i]) pid_claim(old_map[i], old_map[i]->pid);
     }
+
+    if (old_map  != first_pid_map)   free(old_map);
+    if (old_free != first_free_pids) free(old_free);
     return 0;
 }
 
-// Get the next available pid
-// returns -1 if proc_table is full
-int get_next_pid() {
-    int next_pid = -1;
-
-    for (int i = last_pid_created + 1; i % MAXPROC != last_pid_created % MAXPROC; i++) {
-        pcb *proc = get_proc(i);
-        if (!proc->is_alive) {
-            next_pid = i;
-            break;
+// returns the size class for a stack of the given size, or -1 if it is too large to cache
+// *size is rounded up to the size of the class (or to a whole page if it has none)
+static int stack_class(size_t *size) {
+    size_t class_size = USLOSS_MIN_STACK;
+    for (int i = 0; i < STACK_CLASSES; i++, class_size *= 2) {
+        if (*size <= class_size) {
+            *size = class_size;
+            return i;
+        }
+    }
+    size_t page = getpagesize();
+    *size = (*size + page - 1) / page * page;
+    return -1;
+}
+
+// get a stack of at least stacksize bytes, from the pool if one is cached
+// the usable size is stored in *mapped_size
+// called with interrupts disabled; a new stack is mapped with them put back to old_psr
+// returns NULL if a new stack could not be mapped
+static char * stack_alloc(int stacksize, int *mapped_size, unsigned int old_psr) {
+    size_t size = stacksize;
+    int    cls  = stack_class(&size);
+    *mapped_size = size;
+
+    if (cls != -1 && stack_pool[cls]) {
+        free_stack *stack = stack_pool[cls];
+        stack_pool[cls] = stack->next;
+        stack_stats.hits++;
+        stack_stats.bytes_cached -= size;
+        return (char *)stack;
+    }
+    stack_stats.misses++;
+
+    // map the guard page and the stack together, then revoke access to the guard
+    // the system calls touch nothing of ours, so interrupts can be taken meanwhile
+    restore_interrupts(old_psr);
+    size_t page = getpagesize();
+    char  *base = mmap(NULL, size + page, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base != MAP_FAILED && mprotect(base, page, PROT_NONE) == -1) {
+        munmap(base, size + page);
+        base = MAP_FAILED;
+    }
+    check_and_disable(__func__);
+
+    if (base == MAP_FAILED) return NULL;
+    stack_stats.bytes_mapped += size;
+    return base + page;
+}
+
+// give a stack from stack_alloc back to the pool, or unmap it if the pool can't hold it
+static void stack_free(char *stack, int size) {
+    size_t class_size = size;
+    int    cls        = stack_class(&class_size);
+
+    if (cls != -1 && stack_stats.bytes_cached + size <= STACK_POOL_MAX_BYTES) {
+        free_stack *cached = (free_stack *)stack;
+        cached->next    = stack_pool[cls];
+        stack_pool[cls] = cached;
+        stack_stats.releases++;
+        stack_stats.bytes_cached += size;
+        return;
+    }
+
+    size_t page = getpagesize();
+    munmap(stack - page, size + page);
+    stack_stats.evictions++;
+    stack_stats.bytes_mapped -= size;
+}
+
+// copies out the stack pool counters
+void getStackPoolStats(StackPoolStats *stats) {
+    *stats = stack_stats;
+}
+
+// take an unused PCB from the arena, allocating a new chunk if none are left
+// returns NULL if the memory could not be allocated
+static pcb * pcb_alloc() {
+    if (!free_pcbs) {
+        pcb **chunks = realloc(proc_chunks, (num_chunks + 1) * sizeof(pcb *));
+        if (!chunks) return NULL;
+        proc_chunks = chunks;
+
+        pcb      *chunk = aligned_alloc(_Alignof(pcb), MAXPROC * sizeof(pcb));
+        pcb_cold *cold  = malloc(MAXPROC * sizeof(pcb_cold));
+        if (!chunk || !cold) {
+            free(chunk);
+            free(cold);
+            return NULL;
         }
-    } return next_pid;
+        memset(chunk, 0, MAXPROC * sizeof(pcb));
+        proc_chunks[num_chunks] = chunk;
+
+        for (int i = MAXPROC - 1; i >= 0; i--) {
+            chunk[i].slot     = num_chunks * MAXPROC + i;
+            chunk[i].cold     = &cold[i];
+            chunk[i].next_run = free_pcbs;
+            free_pcbs         = &chunk[i];
+        }
+        num_chunks++;
+    }
+
+    pcb *proc = free_pcbs;
+    free_pcbs = proc->next_run;
+    proc->next_run = NULL;
+    memset(&proc->cold->acct, 0, sizeof(proc_acct));
+    num_procs++;
+    return proc;
+}
+
+// clear a PCB, release its pid, and return it to the arena
+static void pcb_free(pcb *proc) {
+    int       slot = proc->slot;
+    pcb_cold *cold = proc->cold;
+
+    // spork() fills in every cold field, so only the hot part needs clearing
+    pid_release(proc);
+    memset(proc, 0, sizeof(pcb));
+    proc->slot     = slot;
+    proc->cold     = cold;
+    proc->next_run = free_pcbs;
+    free_pcbs      = proc;
+    num_procs--;
+}
+
+// Get the next available pid
+// this is the first pid after last_pid_created whose map entry is free
+// returns -1 if the process table is full
+static int get_next_pid() {
+    if (num_procs >= max_procs) return -1;
+
+    // grow the map if every entry is taken but the limit allows more
+    if (num_procs >= pid_map_size && pid_map_grow() == -1) return -1;
+
+    int last_idx = last_pid_created % pid_map_size;
+    int start    = (last_pid_created + 1) % pid_map_size;
+
+    // the entry of the last pid is never a candidate, even if it has been freed
+    unsigned long long last_bit = free_pids[last_idx / 64] & (1ULL << (last_idx % 64));
+    free_pids[last_idx / 64] &= ~last_bit;
+    int idx = pid_find_free(start);
+    free_pids[last_idx / 64] |= last_bit;
+
+    if (idx == -1) return -1;
+    return last_pid_created + 1 + (idx - start + pid_map_size) % pid_map_size;
 }
 
-// return a pointer to the current running process
-pcb * get_proc(int pid) {
-    return &(proc_table[pid % MAXPROC]);
+// return a pointer to the process with the given pid
+// returns NULL if no live (or unjoined) process has that pid
+static pcb * get_proc(int pid) {
+    if (pid < 0) return NULL;
+    pcb *proc = pid_map[pid % pid_map_size];
+    return (proc && proc->pid == pid) ? proc : NULL;
 }
 
 // verifies that the program is currently running in kernel mode and halts if not 
-void check_kernel_mode(const char *func) {
+static void check_kernel_mode(const char *func) {
     unsigned int cur_psr = USLOSS_PsrGet();
     if (!(cur_psr & USLOSS_PSR_CURRENT_MODE)) {
         // not in kernel mode, halt simulation
@@ -127,7 +616,9 @@ void check_kernel_mode(const char *func) {
 }
 
 // updates psr to turn interrupts on
-void enable_interrupts() {
+static void enable_interrupts() {
+    irqsoff_end();
+
     // enable interrupts
     int psr_status = USLOSS_PsrSet(USLOSS_PsrGet() | USLOSS_PSR_CURRENT_INT);
 
@@ -140,7 +631,7 @@ void enable_interrupts() {
 
 // updates psr to turn interrupts off
 // return the old status so that interrupts may be reset later
-unsigned int disable_interrupts() {
+static unsigned int disable_interrupts() {
     // retrieve current psr
     unsigned int old_psr = USLOSS_PsrGet();
 
@@ -152,13 +643,16 @@ unsigned int disable_interrupts() {
         USLOSS_Console("ERROR: Failed to disable interrupts!\n");
         USLOSS_Halt(1);
     }
+    if (old_psr & USLOSS_PSR_CURRENT_INT) irqsoff_begin(NULL);
 
     // return previous psr
     return old_psr;
 }
 
 // updates psr status to reinstate old interrupt status
-void restore_interrupts(unsigned int old_psr) {
+static void restore_interrupts(unsigned int old_psr) {
+    if (old_psr & USLOSS_PSR_CURRENT_INT) irqsoff_end();
+
     int psr_status = USLOSS_PsrSet(old_psr);
 
     // halt simulation if psr_status is nonzero
@@ -169,9 +663,76 @@ void restore_interrupts(unsigned int old_psr) {
 }
 
 // check for kernel mode -- save and disable interrupts
-unsigned int check_and_disable(const char *func) {
+static unsigned int check_and_disable(const char *func) {
     check_kernel_mode(func);
-    return disable_interrupts();
+    unsigned int old_psr = disable_interrupts();
+    if (old_psr & USLOSS_PSR_CURRENT_INT) irqsoff_where = func;
+    return old_psr;
+}
+
+// check_and_disable(), for the other phases: brackets a critical section with criticalExit()
+unsigned int criticalEnter(const char *func) {
+    return check_and_disable(func);
+}
+
+void criticalExit(unsigned int old_psr) {
+    restore_interrupts(old_psr);
+}
+
+/*
+ * measuring how long interrupts stay off
+ * a stretch starts when a disable finds them on, and ends when they are turned back on,
+ * possibly in another process.  the clock is the host's, so timing never touches USLOSS's
+ * each stretch costs two host clock reads, so nothing is timed until someone asks for the stats
+ * by calling resetIrqsOffStats(); until then the PSR path pays one flag test
+ */
+
+static long long irqsoff_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void irqsoff_begin(const char *func) {
+    if (!irqsoff_timing) return;
+    irqsoff_start = irqsoff_clock_ns();
+    irqsoff_where = func;
+}
+
+static void irqsoff_end() {
+    if (!irqsoff_start) return;
+
+    long long span = irqsoff_clock_ns() - irqsoff_start;
+    irqsoff_start = 0;
+    irqsoff_stats.sections++;
+    if (span > irqsoff_stats.max_ns) {
+        irqsoff_stats.max_ns    = span;
+        irqsoff_stats.max_where = irqsoff_where ? irqsoff_where : "?";
+    }
+}
+
+void getIrqsOffStats(IrqsOffStats *stats) {
+    *stats = irqsoff_stats;
+}
+
+// also starts the timing, the first time
+void resetIrqsOffStats() {
+    memset(&irqsoff_stats, 0, sizeof(IrqsOffStats));
+    irqsoff_timing = 1;
+}
+
+// if the named environment variable is set, passes its value to set
+// halts if it is not a number, or set rejects it
+static void env_ms(const char *name, int (*set)(int)) {
+    char *value = getenv(name);
+    if (!value) return;
+
+    char *end;
+    long  ms = strtol(value, &end, 10);
+    if (!*value || *end || ms != (int)ms || set(ms) == -1) {
+        USLOSS_Console("ERROR: Bad value '%s' for %s.\n", value, name);
+        USLOSS_Halt(1);
+    }
 }
 
 //sets up proc table
@@ -179,36 +740,60 @@ void phase1_init() {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
 
-    // initialize the process table to zeros
-    for (int i=0; i < MAXPROC; i++) {
-        memset(&(proc_table[i]), 0, sizeof(pcb));
+    // set up the first chunk of the process table; later chunks are allocated on demand
+    memset(first_chunk, 0, sizeof(first_chunk));
+    proc_chunks = realloc(proc_chunks, sizeof(pcb *));
+    proc_chunks[0] = first_chunk;
+    num_chunks = 1;
+    num_procs  = 0;
+    free_pcbs  = NULL;
+    for (int i = MAXPROC - 1; i >= 0; i--) {
+        first_chunk[i].slot     = i;
+        first_chunk[i].cold     = &first_cold_chunk[i];
+        first_chunk[i].next_run = free_pcbs;
+        free_pcbs               = &first_chunk[i];
     }
 
-    // initialize the run-queue array
-    for (int i = 0; i < 6; i++) queues[i] = NULL;
+    // initialize the pid map with every entry free
+    memset(first_pid_map, 0, sizeof(first_pid_map));
+    memset(first_free_pids, 0, sizeof(first_free_pids));
+    for (int i = 0; i < MAXPROC; i++) first_free_pids[i / 64] |= 1ULL << (i % 64);
+
+    // choose the scheduling policy: PHASE1_SCHED in the environment, or strict priority
+    char *sched_name = getenv("PHASE1_SCHED");
+    sched = &sched_priority;
+    if (sched_name && setScheduler(sched_name) == -1) {
+        USLOSS_Console("ERROR: Unknown scheduler '%s' in PHASE1_SCHED.\n", sched_name);
+        USLOSS_Halt(1);
+    }
+    sched->init();
+    env_ms("PHASE1_QUANTUM_MS", setQuantum);
+    env_ms("PHASE1_AGING_MS",   setAging);
+    env_ms("PHASE1_TRACE",      traceStart);   // not ms: the ring size; the latencies are dumped at halt
 
     // initialize process table entry for init process
-    pcb * init_pcb = get_proc(1);
+    pcb * init_pcb = pcb_alloc();
+    pid_claim(init_pcb, 1);
 
-    init_pcb->name     = "init";
-    init_pcb->pid      = 1;
-    init_pcb->priority = 6;
-    init_pcb->is_alive = 1;
+    init_pcb->cold->name  = "init";
+    init_pcb->priority    = 6;
+    init_pcb->sched_level = 5;
+    init_pcb->is_alive    = 1;
 
     // update field
     last_pid_created = 1;
 
     // add init to run queue
-    queues[5] = init_pcb;
+    enqueue_proc(init_pcb->pid);
 
     // initialize the context for init
-    USLOSS_ContextInit(&(init_pcb->context), init_stack, USLOSS_MIN_STACK, NULL, init_main);
+    USLOSS_ContextInit(&init_pcb->cold->context, init_stack, USLOSS_MIN_STACK, NULL, init_main);
 
     restore_interrupts(old_psr);
 }
 
 // function contents for the 'init' process
-void init_main() {
+static void init_main() {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
 
@@ -236,7 +821,7 @@ void init_main() {
 }
 
 // self explanatory
-int testcase_main_wrapper() {
+static int testcase_main_wrapper() {
     // check for kernel mode
     check_kernel_mode(__func__);
 
@@ -251,6 +836,8 @@ int testcase_main_wrapper() {
 
     // halt simulation since main function returned
     if (status != 0) USLOSS_Console("An ERROR was reported by a testcase! Halting simulation.\n");
+    if (getenv("PHASE1_TRACE")) dumpSchedLatency();
+    if (getenv("PHASE1_TOP"))   dumpTop();
 
     USLOSS_Halt(status);
 
@@ -277,35 +864,54 @@ int spork(char *name, int(*func)(void *), void *arg, int stacksize, int priority
             (priority  > 5))
         return -1;
 
+    // get stack memory for process
+    // if a new stack has to be mapped, interrupts are taken meanwhile; their wakeups must not
+    // switch away from us before the child is set up, so they wait for the preemptEnable() below
+    int    stack_size;
+    preemptDisable();
+    char * stack = stack_alloc(stacksize, &stack_size, old_psr);
+    if (!stack) {
+        preemptEnable();
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
     // retrieve parent, child process references
     pcb * parent_proc  = cur_proc;
-    pcb * child_proc   = get_proc(child_pid);
-
-    // allocate stack memory for process
-    char * stack = malloc(stacksize);
+    pcb * child_proc   = pcb_alloc();
+    if (!child_proc) {
+        stack_free(stack, stack_size);
+        preemptEnable();
+        restore_interrupts(old_psr);
+        return -1;
+    }
+    pid_claim(child_proc, child_pid);
 
     // fill in information on child process
-    child_proc->parent   = parent_proc;
-    child_proc->pid      = child_pid;
-    child_proc->priority = priority;
-    child_proc->is_alive = 1;
-    child_proc->name     = name;
-    child_proc->func     = func;
-    child_proc->arg      = arg;
-    child_proc->stack    = stack;
+    child_proc->parent      = parent_proc;
+    child_proc->priority    = priority;
+    child_proc->sched_level = priority - 1;
+    child_proc->is_alive    = 1;
+    child_proc->cold->name       = name;
+    child_proc->cold->func       = func;
+    child_proc->cold->arg        = arg;
+    child_proc->cold->stack      = stack;
+    child_proc->cold->stack_size = stack_size;
 
     // add child proc to list of children of parent proc by placing it at the front of the list
     child_proc->next_sibling = parent_proc->first_child;
+    if (parent_proc->first_child) parent_proc->first_child->prev_sibling = child_proc;
     parent_proc->first_child = child_proc;
 
     // initialize a context for the child proc
-    USLOSS_ContextInit(&child_proc->context, stack, stacksize, NULL, funcWrapper);
+    USLOSS_ContextInit(&child_proc->cold->context, stack, stack_size, NULL, funcWrapper);
 
     // place the process at the end of its run queue
     enqueue_proc(child_pid);
 
-    // call the dispatcher to see if the new child will run
-    dispatcher();
+    // call the dispatcher to see if the new child will run; the same call serves any wakeup held off above
+    requestResched();
+    preemptEnable();
 
     restore_interrupts(old_psr);
 
@@ -313,16 +919,17 @@ int spork(char *name, int(*func)(void *), void *arg, int stacksize, int priority
 }
 
 // wrapper for main() function of process
-void funcWrapper() {
+static void funcWrapper() {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
 
     // retrieve main function and arguments of the current process
-    int (*func)(void *) = cur_proc->func;
-    void *arg           = cur_proc-> arg;
+    int (*func)(void *) = cur_proc->cold->func;
+    void *arg           = cur_proc->cold->arg;
 
-    // enable interrupts before function call
-    enable_interrupts();
+    // start in kernel mode with interrupts enabled, and nothing left over
+    // in the previous-mode bits from whoever created us
+    restore_interrupts(USLOSS_PSR_CURRENT_MODE | USLOSS_PSR_CURRENT_INT);
     
     // call the function, store its return value as process status
     int status = func(arg);
@@ -337,7 +944,34 @@ void funcWrapper() {
     quit(status);
 }
 
+// collect the status of a terminated child, unlink it from its parent, and free its pcb
+// returns the pid of the child
+static int reap_child(pcb *child, int *status) {
+    pcb *parent = child->parent;
+    int  pid    = child->pid;
+
+    *status = child->status;                 // fill the status pointer with the status of the child
+    stack_free(child->cold->stack, child->cold->stack_size); // return the stack to the pool
+
+    // delete the child from the list of children
+    if (child->prev_sibling) child->prev_sibling->next_sibling = child->next_sibling;
+    else                     parent->first_child               = child->next_sibling;
+    if (child->next_sibling) child->next_sibling->prev_sibling = child->prev_sibling;
+
+    // delete the child from the zombie list
+    if (child->prev_zombie)  child->prev_zombie->next_zombie   = child->next_zombie;
+    else                     parent->first_zombie              = child->next_zombie;
+    if (child->next_zombie)  child->next_zombie->prev_zombie   = child->prev_zombie;
+    else                     parent->last_zombie               = child->prev_zombie;
+
+    // clear the slot in the process table
+    pcb_free(child);
+
+    return pid;
+}
+
 // blocks the currently running process until one of its children has terminated
+// if several have, the most recently created one is joined first
 int join(int *status) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
@@ -346,61 +980,46 @@ int join(int *status) {
     if (!status               ) return -3; // status is NULL
     if (!cur_proc->first_child) return -2; // process has no children to join
 
-    int   pid_of_child_joined_to = -1;
-
-    // set up pointers to loop through the list
-    pcb * prev = NULL;
-    pcb * cur  = cur_proc->first_child;
+    // block until some child has terminated
+    while (!cur_proc->first_zombie) {
+        cur_proc->in_join = 1; // set flag to indicate process has blocked in join
+        blockMe();
+    }
 
-    // repeat until some child joins
-    while (1) {
-        // loop over the children to see if any need their status collected
-        cur = cur_proc->first_child;
-        prev = NULL;
-        while (cur) {
-            
-            // execute if a child is marked to terminate
-            if (cur->termination) {
-
-                *status = cur->status;             // fill the status pointer with the status of the child
-                free(cur->stack);             // free the stack memory
-                pid_of_child_joined_to = cur->pid; // save the pid to return
-
-                pcb * temp = cur;                  // save reference of pcb to be cleared
-
-                // delete the child from the list of children
-                if (prev == NULL) {
-                    cur_proc->first_child = cur->next_sibling;
-                } else {
-                    prev->next_sibling = cur->next_sibling;
-                } cur = cur->next_sibling;
-
-                // clear the slot in the process table
-                memset(temp, 0, sizeof(pcb));
-
-                break;
-                                                       
-            } else {
-                prev = cur;
-                cur  = cur->next_sibling;
-            }
-        }
+    int pid_of_child_joined_to = reap_child(cur_proc->first_zombie, status);
 
-        if (pid_of_child_joined_to == -1) {
-            cur_proc->in_join = 1; // set flag to indicate process has blocked in join
-            blockMe();             // block if no children have terminated
-        } else break;              // otherwise, return
-    }
     restore_interrupts(old_psr);
     return pid_of_child_joined_to;
 }
 
-// marks the process with the given pid for termination
-// the marked process must call quit() on its own
-void zap(int pid) {
+// blocks the currently running process until the child with the given pid has terminated
+// returns -2 if there is no such child, -3 if status is NULL
+int joinPid(int pid, int *status) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
 
+    pcb *child = get_proc(pid);
+
+    // error checking
+    if (!status                                ) return -3; // status is NULL
+    if (!child || child->parent != cur_proc    ) return -2; // not one of our children
+
+    // block until that child has terminated; other children quitting don't wake us
+    while (!child->termination) {
+        cur_proc->join_target = child;
+        cur_proc->in_join     = 1;
+        blockMe();
+    }
+    cur_proc->join_target = NULL;
+
+    int pid_of_child_joined_to = reap_child(child, status);
+
+    restore_interrupts(old_psr);
+    return pid_of_child_joined_to;
+}
+
+// returns the process with the given pid, halting the simulation if it may not be zapped
+static pcb * zap_check(int pid) {
     // retrieve a reference to the desired process
     pcb *proc_toZap = get_proc(pid);
 
@@ -408,32 +1027,115 @@ void zap(int pid) {
     if (pid == cur_proc->pid) {  // trying to zap itself
         USLOSS_Console("ERROR: Attempt to zap() itself.\n");
         USLOSS_Halt(1);
-    } else if (!scan_table(pid)) {  // trying to zap a process that is not in the table regardless of living status
+    } else if (!proc_toZap) {  // trying to zap a process that is not in the table regardless of living status
         USLOSS_Console("ERROR: Attempt to zap() a non-existent process.\n");
         USLOSS_Halt(1);
-    } else if (!proc_toZap->is_alive ||   // trying to zap a non-existent process
-            proc_toZap->termination) { // trying to zap a terminated process
+    } else if (proc_toZap->termination) { // trying to zap a terminated process
         USLOSS_Console("ERROR: Attempt to zap() a process that is already in the process of dying.\n");
         USLOSS_Halt(1);
     } else if (pid == 1) {             // trying to zap init
         USLOSS_Console("ERROR: Attempt to zap() init.\n");
         USLOSS_Halt(1);
     }
+    return proc_toZap;
+}
 
-    // add self to zap queue
-    if (!proc_toZap->first_zap) {
-        proc_toZap->first_zap = cur_proc;
-    } else {
-        cur_proc->next_zap = proc_toZap->first_zap;
-        proc_toZap->first_zap = cur_proc;
-    }
+// adds the current process to target's zap list, using wait
+static void zap_add(pcb *target, zap_wait *wait) {
+    wait->zapper      = cur_proc;
+    wait->next        = target->first_zap;
+    target->first_zap = wait;
+    cur_proc->zap_pending++;
+}
 
-    // block until process dies
+// blocks until every target zap_add() was called for has quit; quit() wakes us for the last one
+static void zap_block() {
     cur_proc->in_zap = 1;
-    blockMe();
+    while (cur_proc->zap_pending) block_cur();
     cur_proc->in_zap = 0;
-    
+}
+
+// the process after proc in a preorder walk of the subtree rooted at root, or NULL at the end
+static pcb * tree_next(pcb *proc, pcb *root) {
+    if (proc->first_child) return proc->first_child;
+    while (proc != root) {
+        if (proc->next_sibling) return proc->next_sibling;
+        proc = proc->parent;
+    }
+    return NULL;
+}
+
+// marks the process with the given pid for termination
+// the marked process must call quit() on its own
+void zap(int pid) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    zap_wait wait;
+    zap_add(zap_check(pid), &wait);
+
+    // block until process dies
+    zap_block();
+
+    restore_interrupts(old_psr);
+}
+
+// zap() for n processes at once: blocks once, until all of them have quit
+// every pid is checked, as zap() would, before any is marked; a pid may appear more than once
+// a negative n halts, as a bad pid would
+void zapMany(int *pids, int n) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    if (n < 0 || (n && !pids)) {
+        USLOSS_Console("ERROR: Bad pid list (n = %d) passed to zapMany().\n", n);
+        USLOSS_Halt(1);
+    }
+    for (int i = 0; i < n; i++) zap_check(pids[i]);
+
+    zap_wait *waits = malloc(n * sizeof(zap_wait));
+    if (n && !waits) {
+        USLOSS_Console("ERROR: Out of memory in zapMany().\n");
+        USLOSS_Halt(1);
+    }
+    for (int i = 0; i < n; i++) zap_add(get_proc(pids[i]), &waits[i]);
+
+    zap_block();
+    free(waits);
+
+    restore_interrupts(old_psr);
+}
+
+// zaps the process with the given pid and all of its descendants, blocking once, until all of
+// them have quit; descendants that have already quit (and wait to be joined) are left alone
+// the pid is checked as zap() would; the caller may not be one of the descendants
+// returns the number of processes zapped
+int zapTree(int pid) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    pcb *root = zap_check(pid);
+
+    int n = 0;
+    for (pcb *proc = root; proc; proc = tree_next(proc, root)) {
+        if (proc == cur_proc) zap_check(cur_proc->pid);
+        if (!proc->termination) n++;
+    }
+
+    zap_wait *waits = malloc(n * sizeof(zap_wait));
+    if (n && !waits) {
+        USLOSS_Console("ERROR: Out of memory in zapTree().\n");
+        USLOSS_Halt(1);
+    }
+    int i = 0;
+    for (pcb *proc = root; proc; proc = tree_next(proc, root))
+        if (!proc->termination) zap_add(proc, &waits[i++]);
+
+    zap_block();
+    free(waits);
+
     restore_interrupts(old_psr);
+    return n;
 }
 
 // quits the current process, marking it for termination
@@ -451,18 +1153,40 @@ void quit(int status) {
     cur_proc->status        = status;
     cur_proc->termination   = 1;
 
-    // if the parent is waiting in a join, unblock it
-    if (cur_proc->parent->in_join) {
-        cur_proc->parent->in_join = 0;
-        unblockProc(cur_proc->parent->pid);
+    // add self to the parent's zombie list, which join() pops newest-first
+    // children usually quit oldest- or newest-first, so check both ends before walking
+    pcb *parent = cur_proc->parent;
+    pcb *after  = NULL;
+    if (parent->last_zombie && parent->last_zombie->pid > cur_proc->pid) {
+        after = parent->last_zombie;
+    } else if (parent->first_zombie && parent->first_zombie->pid > cur_proc->pid) {
+        after = parent->first_zombie;
+        while (after->next_zombie->pid > cur_proc->pid) after = after->next_zombie;
     }
 
-    // clear the zappers
-    while (cur_proc->first_zap) {
-        unblockProc(cur_proc->first_zap->pid);
-        cur_proc->first_zap = cur_proc->first_zap->next_zap;
+    cur_proc->prev_zombie = after;
+    cur_proc->next_zombie = after ? after->next_zombie : parent->first_zombie;
+    if (cur_proc->prev_zombie) cur_proc->prev_zombie->next_zombie = cur_proc;
+    else                       parent->first_zombie               = cur_proc;
+    if (cur_proc->next_zombie) cur_proc->next_zombie->prev_zombie = cur_proc;
+    else                       parent->last_zombie                = cur_proc;
+
+    // if the parent is waiting in a join (for us, if it is waiting on one child), unblock it
+    // (the parent and the zappers are all made runnable first; the dispatcher below picks among them once)
+    if (parent->in_join && (!parent->join_target || parent->join_target == cur_proc)) {
+        parent->in_join = 0;
+        wake_proc(parent);
     }
 
+    // clear the zappers; one that zapped several processes only wakes when the last of them quits
+    zap_wait *wait = cur_proc->first_zap;
+    while (wait) {
+        zap_wait *next = wait->next;
+        if (--wait->zapper->zap_pending == 0) wake_proc(wait->zapper);
+        wait = next;
+    }
+    cur_proc->first_zap = NULL;
+
     // removes the current process from whichever priority queue is exists on
     dequeue_proc();
 
@@ -475,153 +1199,1399 @@ void quit(int status) {
     while(1);
 }
 
-// enqueue a process into one of the priority queues based on the priority filed in the proc pcb
-void enqueue_proc(int pid) {
-    // retrieve a reference to the desired process
-    pcb *proc_toEnqueue = get_proc(pid);
-    
-    // enqueue the process if it is alive, not marked for termination, and not blocked
-    if (proc_toEnqueue->is_alive &&
-            !proc_toEnqueue->termination &&
-            !proc_toEnqueue->is_blocked) {
-
-        pcb *queue          = queues[proc_toEnqueue->priority - 1];     // get proper queue pointer
-        pcb *cur            = queue;                                    // get pointer to head
-        int  queue_num      = proc_toEnqueue->priority - 1;             // get queue row
-        
-        proc_toEnqueue->next_run = NULL;
-
-        // if queue is empty then place proc at the head of the priority queue
-        if (!queue) { 
-            queues[queue_num] = proc_toEnqueue;
-        // if the queue is not empty then place the new process at the end 
-        } else {    
-            while (cur->next_run) {
-                cur = cur->next_run;
-            }
-            cur->next_run = proc_toEnqueue;
-        }
-    }
-}
+/*
+ * run queues shared by the policies below
+ */
 
-// dequeue the current process from whichever priority queue it resides on
-void dequeue_proc() {
-    pcb * queue = queues[cur_proc->priority - 1];
-    int pid     = getpid();
+// link a process in after the tail of the given queue
+// O(1): the queue keeps a tail pointer
+static void rq_push(int queue_num, pcb *proc) {
+    run_queue *queue = &queues[queue_num];
 
-    // set defaults
-    pcb * prev      = NULL;                         
-    pcb * cur       = queue;
-    int   queue_num = cur_proc->priority - 1;
+    proc->queue_num = queue_num;
+    proc->next_run  = NULL;
+    proc->prev_run  = queue->tail;
 
-    // iterate until we find the current process and remove it from the queue corresponding to its priority
-    while (cur) {
-        if (cur->pid == pid) {
-            if (prev == NULL) queues[queue_num] = cur->next_run;
-            else              prev->next_run    = cur->next_run;
-            break;
-        } else {
-            prev = cur;
-            cur  = cur->next_run;
-        }
-    }
+    // if queue is empty then place proc at the head of the queue
+    // otherwise place the new process after the tail
+    if (!queue->tail) queue->head           = proc;
+    else              queue->tail->next_run = proc;
+    queue->tail = proc;
+
+    // mark the queue as non-empty
+    queue_bitmap |= 1u << queue_num;
 }
 
-// blocks the currently running process
-// can only be awoken by calling unblockProc
-void blockMe() {
-    // disable interrupts, save old interrupt state, check for kernel mode
-    unsigned int old_psr = check_and_disable(__func__);
+// unlink a process from its queue
+// O(1): the queue links are doubly linked
+static void rq_unlink(pcb *proc) {
+    run_queue *queue = &queues[proc->queue_num];
 
-    // mark current process as blocked
-    cur_proc->is_blocked = 1;
+    if (proc->prev_run) proc->prev_run->next_run = proc->next_run;
+    else                queue->head              = proc->next_run;
 
-    // remove it from the run-queue
-    dequeue_proc();
+    if (proc->next_run) proc->next_run->prev_run = proc->prev_run;
+    else                queue->tail              = proc->prev_run;
 
-    // call the dispatcher to decide what process to run next
-    dispatcher();
-    
-    restore_interrupts(old_psr);
+    proc->next_run = proc->prev_run = NULL;
+
+    // mark the queue as empty if that was its last entry
+    if (!queue->head) queue_bitmap &= ~(1u << proc->queue_num);
 }
 
-// wakes up a blocked process and reinstates it onto the priority queues
-// the awoken process may or may not run depending on the decision of the dispatcher
-int unblockProc(int pid) {
-    // disable interrupts, save old interrupt state, check for kernel mode
-    unsigned int old_psr = check_and_disable(__func__);
+// return the process at the head of the lowest-numbered non-empty queue
+// O(1): find-first-set on the queue bitmap
+static pcb * rq_first() {
+    if (!queue_bitmap) return NULL;
+    return queues[__builtin_ffs(queue_bitmap) - 1].head;
+}
 
-    // retrieve a reference to the desired process
-    pcb * proc_toUnblock = get_proc(pid);
-    //USLOSS_Console("Unblocking %s : %d", proc_toUnblock->name, proc_toUnblock->pid);
+static void rq_init() {
+    for (int i = 0; i < 6; i++) queues[i].head = queues[i].tail = NULL;
+    queue_bitmap = 0;
+}
 
-    // perform error checking
-    if (!proc_toUnblock->is_blocked || !proc_toUnblock->is_alive) return -2;
+/*
+ * "priority": strict priority, round robin within a priority every prio_quantum ms
+ * with aging on, a process that has waited aging_ms on its queue moves up one
+ * queue (and starts waiting again), until it runs; it goes back to the queue of
+ * its priority the next time it becomes runnable.  each queue is in order of
+ * age_since, so only the heads need checking.  init's queue does not age
+ */
 
-    // mark the process as unblocked
-    proc_toUnblock->is_blocked = 0;
-    
-    // place the process at the end of the appropriate run queue
-    enqueue_proc(pid);
+static void prio_enqueue(pcb *proc)       { rq_push(proc->priority - 1, proc); }
+static void prio_tick(pcb *proc, int used) { }
+static int  prio_quantum_for(pcb *proc)   { return prio_quantum; }
+
+static pcb * prio_pick_next() {
+    if (aging_ms && queue_bitmap) {
+        int now = time_ofLastCharge;
+        for (int q = __builtin_ffs(queue_bitmap); q < 5; q++) {
+            pcb *proc;
+            while ((proc = queues[q].head) && now - proc->age_since >= aging_ms * 1000) {
+                rq_unlink(proc);
+                rq_push(q - 1, proc);
+                proc->age_since = now;
+            }
+        }
+    }
+    return rq_first();
+}
 
-    // if the current running process has zappers, return so that they may be woken up too
-    if (cur_proc->first_zap != NULL) {return 0;}
+static const sched_ops sched_priority = {
+    "priority", rq_init, prio_enqueue, rq_unlink, prio_pick_next, prio_tick, prio_quantum_for
+};
 
-    // call the dispatcher to see if the awoken process needs to be switched to 
-    dispatcher();
+/*
+ * "mlfq": multi-level feedback queue
+ * a process starts at the level of its priority, and drops a level each time
+ * it uses up that level's quantum (blocking early does not reset the count)
+ * every MLFQ_BOOST_MS, every process goes back to the level of its priority:
+ * the runnable ones that sank are kept on a list and moved at once, and the
+ * others catch up when they are next queued, so a boost never walks the table
+ * init (priority 6) stays on the bottom level, and nothing else sinks to it
+ */
 
-    restore_interrupts(old_psr);
-    return 0;
+#define MLFQ_BOOST_MS 1000
+
+static const int mlfq_quanta[6] = { 10, 20, 40, 80, 160, 80 };   // ms, by level
+static int       mlfq_last_boost;
+static int       mlfq_epoch;        // boosts so far
+static pcb      *mlfq_demoted;      // runnable processes below the level of their priority
+
+static void mlfq_init() {
+    rq_init();
+    mlfq_last_boost = -1;
+    mlfq_demoted    = NULL;
 }
 
-// deciphers which process is at the head of the highest non-empty priority queue
-// this process may or may not be the active process
-// depending on the current process (and how long it has been active), a context switch may 
-// turn on the chosen process, turn off the chosen process, or do nothing if the chosen process
-// has not been running for its promised time
-void dispatcher() {
+// put a process back on the level of its priority if there has been a boost since it was last queued
+static void mlfq_catch_up(pcb *proc) {
+    if (proc->sched_epoch == mlfq_epoch) return;
+    proc->sched_epoch = mlfq_epoch;
+    proc->sched_level = proc->priority - 1;
+    proc->sched_used  = 0;
+}
 
-    unsigned int old_psr = check_and_disable(__func__);
+static void mlfq_enqueue(pcb *proc) {
+    mlfq_catch_up(proc);
+    rq_push(proc->sched_level, proc);
 
-    // choose which process will run next
-    pcb * proc_toRun = NULL;
-    for (int i = 0; i < 6; i++) {
-        if (queues[i]) {
-            proc_toRun = queues[i];
-            break;
-        }
+    if (proc->sched_level != proc->priority - 1) {
+        proc->prev_demoted = NULL;
+        proc->next_demoted = mlfq_demoted;
+        if (mlfq_demoted) mlfq_demoted->prev_demoted = proc;
+        mlfq_demoted = proc;
     }
+}
 
-    // if the same process is at the head of the first non-empty priority queue
-    if (proc_toRun->pid == cur_proc->pid) {
-        
-        int cur_time = currentTime();
-        int elapsed = (cur_time - time_ofLastSwitch)/1000;
+static void mlfq_dequeue(pcb *proc) {
+    rq_unlink(proc);
 
-        // if the current process is done, then requeue it and call the dispatcher again
-        if (elapsed >= 80) {
-            dequeue_proc();
-            enqueue_proc(cur_proc->pid);
-            dispatcher();
-        }
-        restore_interrupts(old_psr);
-        return;
+    if (proc->sched_level != proc->priority - 1) {
+        if (proc->prev_demoted) proc->prev_demoted->next_demoted = proc->next_demoted;
+        else                    mlfq_demoted                     = proc->next_demoted;
+        if (proc->next_demoted) proc->next_demoted->prev_demoted = proc->prev_demoted;
     }
-    // if there is a new process that needs to run
-    else if (proc_toRun->pid != cur_proc->pid) {
-        dequeue_proc();
-        enqueue_proc(cur_proc->pid);
-        USLOSS_Context *old = &(cur_proc->context);
-        USLOSS_Context *new = &(proc_toRun->context);
+}
 
-        // update current process global
-        cur_proc = proc_toRun;
-        time_ofLastSwitch = currentTime();
-        // perform the context switch
-        USLOSS_ContextSwitch(old, new);
+// move a process to another level, keeping it runnable if it was
+static void mlfq_set_level(pcb *proc, int level) {
+    int queued = proc->on_runq;
+
+    if (queued) mlfq_dequeue(proc);
+    proc->sched_level = level;
+    proc->sched_used  = 0;
+    if (queued) mlfq_enqueue(proc);
+}
+
+static void mlfq_tick(pcb *proc, int used) {
+    int now = currentTime();
+
+    // drop the process a level once it has used up this level's quantum
+    mlfq_catch_up(proc);
+    proc->sched_used += used;
+    if (proc->sched_level < 4 && proc->sched_used >= mlfq_quanta[proc->sched_level] * 1000)
+        mlfq_set_level(proc, proc->sched_level + 1);
+
+    // periodically lift everyone back to the level of their priority, so demoted processes can't starve
+    // (after the charge above, so the CPU used before a boost doesn't count against the new period)
+    if (mlfq_last_boost == -1) mlfq_last_boost = now;
+    if (now - mlfq_last_boost >= MLFQ_BOOST_MS * 1000) {
+        mlfq_last_boost = now;
+        mlfq_epoch++;
+        while (mlfq_demoted) {
+            pcb *p = mlfq_demoted;
+            mlfq_dequeue(p);
+            mlfq_enqueue(p);
+        }
+        mlfq_catch_up(proc);
+    }
+}
+
+static int mlfq_quantum_for(pcb *proc) { return mlfq_quanta[proc->sched_level]; }
+
+// the level a process would be queued on now
+static int mlfq_level(pcb *proc) {
+    return proc->sched_epoch == mlfq_epoch ? proc->sched_level : proc->priority - 1;
+}
+
+static const sched_ops sched_mlfq = {
+    "mlfq", mlfq_init, mlfq_enqueue, mlfq_dequeue, rq_first, mlfq_tick, mlfq_quantum_for
+};
+
+/*
+ * "stride": proportional share
+ * priority p gets 64 >> p tickets; each process has a pass that advances by
+ * STRIDE1 / tickets per us of CPU it uses, and the lowest pass runs next
+ * runnable processes live in a min-heap on pass; init (priority 6) only runs
+ * when the heap is empty
+ */
+
+#define STRIDE1 (1 << 20)
+
+static pcb       **stride_heap;
+static int         stride_count;
+static int         stride_cap;
+static long long   stride_vtime;   // pass of the process at the top of the heap, last we looked
+
+static int stride_of(pcb *proc) { return STRIDE1 / (64 >> proc->priority); }
+
+// heap order: lowest pass first, lowest pid breaks ties
+static int stride_before(pcb *a, pcb *b) {
+    return a->sched_pass < b->sched_pass || (a->sched_pass == b->sched_pass && a->pid < b->pid);
+}
+
+static void stride_place(pcb *proc, int i) {
+    stride_heap[i]   = proc;
+    proc->heap_index = i;
+}
+
+static void stride_sift_up(int i) {
+    pcb *proc = stride_heap[i];
+    while (i > 0 && stride_before(proc, stride_heap[(i - 1) / 2])) {
+        stride_place(stride_heap[(i - 1) / 2], i);
+        i = (i - 1) / 2;
+    }
+    stride_place(proc, i);
+}
+
+static void stride_sift_down(int i) {
+    pcb *proc = stride_heap[i];
+    while (2 * i + 1 < stride_count) {
+        int child = 2 * i + 1;
+        if (child + 1 < stride_count && stride_before(stride_heap[child + 1], stride_heap[child])) child++;
+        if (!stride_before(stride_heap[child], proc)) break;
+        stride_place(stride_heap[child], i);
+        i = child;
+    }
+    stride_place(proc, i);
+}
+
+static void stride_init() {
+    rq_init();
+    stride_count = 0;
+    stride_vtime = 0;
+}
+
+static void stride_enqueue(pcb *proc) {
+    if (proc->priority == 6) {
+        rq_push(5, proc);
+        return;
+    }
+
+    // grow the heap along with the process table
+    if (stride_count == stride_cap) {
+        int   cap  = stride_cap ? stride_cap * 2 : MAXPROC;
+        pcb **heap = realloc(stride_heap, cap * sizeof(pcb *));
+        if (!heap) {
+            USLOSS_Console("ERROR: Out of memory for the stride scheduler!\n");
+            USLOSS_Halt(1);
+        }
+        stride_heap = heap;
+        stride_cap  = cap;
+    }
+
+    // a process that has been blocked doesn't get to bank the CPU it didn't use
+    if (proc->sched_pass < stride_vtime) proc->sched_pass = stride_vtime;
+
+    stride_place(proc, stride_count++);
+    stride_sift_up(proc->heap_index);
+}
+
+static void stride_dequeue(pcb *proc) {
+    if (proc->priority == 6) {
+        rq_unlink(proc);
+        return;
+    }
+
+    int  i    = proc->heap_index;
+    pcb *last = stride_heap[--stride_count];
+    if (i == stride_count) return;
+
+    stride_place(last, i);
+    stride_sift_up(i);
+    stride_sift_down(last->heap_index);
+}
+
+static pcb * stride_pick_next() {
+    if (stride_count) return stride_heap[0];
+    return rq_first();
+}
+
+static void stride_tick(pcb *proc, int used) {
+    if (proc->priority == 6) return;
+
+    // every trip through the dispatcher costs at least a us
+    if (used < 1) used = 1;
+    proc->sched_pass += (long long)stride_of(proc) * used;
+
+    if (proc->on_runq) stride_sift_down(proc->heap_index);
+    if (stride_count) stride_vtime = stride_heap[0]->sched_pass;
+}
+
+static int stride_quantum_for(pcb *proc) { return 20; }
+
+static const sched_ops sched_stride = {
+    "stride", stride_init, stride_enqueue, stride_dequeue, stride_pick_next, stride_tick, stride_quantum_for
+};
+
+static const sched_ops *schedulers[] = { &sched_priority, &sched_mlfq, &sched_stride };
+
+/*
+ * run queue operations used by the rest of phase 1
+ */
+
+// make a process runnable
+static void runq_add(pcb *proc) {
+    // time_ofLastCharge is the last time the dispatcher read the clock -- close enough, and free
+    // (the trace wants better, and pays for a clock read)
+    proc->runq_since = proc->age_since = time_ofLastCharge;
+    if (tracing) proc->runq_since = trace_event(TRACE_ENQUEUE, proc);
+    proc->on_runq = 1;
+    sched->enqueue(proc);
+}
+
+// make a process runnable if it is alive, not marked for termination, not blocked, and not already queued
+static void enqueue_proc(int pid) {
+    // retrieve a reference to the desired process
+    pcb *proc_toEnqueue = get_proc(pid);
+
+    if (proc_toEnqueue &&
+            proc_toEnqueue->is_alive &&
+            !proc_toEnqueue->termination &&
+            !proc_toEnqueue->is_blocked &&
+            !proc_toEnqueue->on_runq)
+        runq_add(proc_toEnqueue);
+}
+
+// make a process not runnable, if it is
+static void runq_remove(pcb *proc) {
+    if (!proc->on_runq) return;
+    sched->dequeue(proc);
+    proc->on_runq = 0;
+}
+
+// dequeue the current process from whichever priority queue it resides on
+static void dequeue_proc() {
+    runq_remove(cur_proc);
+}
+
+// return the process the scheduler wants to run next, or NULL if nothing is runnable
+static pcb * runq_pick() {
+    return sched->pick_next();
+}
+
+// switches to the named scheduling policy ("priority", "mlfq", or "stride")
+// runnable processes are carried over, in the order the old policy would have run them
+// returns -1 if there is no policy with that name
+int setScheduler(const char *name) {
+    unsigned int old_psr = check_and_disable(__func__);
+
+    const sched_ops *new_sched = NULL;
+    for (int i = 0; i < (int)(sizeof(schedulers) / sizeof(schedulers[0])); i++) {
+        if (strcmp(schedulers[i]->name, name) == 0) new_sched = schedulers[i];
+    }
+    if (!new_sched) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    // drain the old policy, chaining the processes through next_run
+    pcb *first = NULL, *last = NULL, *proc;
+    while ((proc = runq_pick())) {
+        runq_remove(proc);
+        if (last) last->next_run = proc;
+        else      first          = proc;
+        last = proc;
+    }
+
+    sched = new_sched;
+    sched->init();
+
+    while (first) {
+        proc  = first;
+        first = proc->next_run;
+        runq_add(proc);
+    }
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// blocks the currently running process
+// can only be awoken by calling unblockProc
+void blockMe() {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    block_cur();
+    
+    restore_interrupts(old_psr);
+}
+
+// blockMe(), for callers that already have interrupts disabled
+static void block_cur() {
+    // mark current process as blocked
+    cur_proc->is_blocked = 1;
+    if (tracing) trace_event(TRACE_BLOCK, cur_proc);
+
+    // remove it from the run-queue
+    dequeue_proc();
+
+    // call the dispatcher to decide what process to run next
+    dispatcher();
+}
+
+// marks a blocked process as runnable, without calling the dispatcher
+// returns -2 if the process is not blocked
+static int wake_proc(pcb *proc) {
+    if (!proc->is_blocked) return -2;
+
+    // mark the process as unblocked
+    proc->is_blocked = 0;
+    proc->trace_woken = 1;
+    if (tracing) trace_event(TRACE_UNBLOCK, proc);
+
+    // place the process at the end of the appropriate run queue
+    enqueue_proc(proc->pid);
+
+    // it should take the CPU from the current process
+    if (proc->priority < cur_proc->priority) need_resched = 1;
+    return 0;
+}
+
+// the dispatcher call after a wakeup
+// with preemption disabled (e.g. inside an interrupt handler), it is left to preemptEnable(), which
+// only calls it if need_resched is set -- so nothing else runs until the handler finishes, and the
+// dispatcher runs once
+static void wake_dispatch() {
+    if (!preempt_count) dispatcher();
+}
+
+// keeps wakeups from switching processes, without turning interrupts off; calls nest
+void preemptDisable() {
+    preempt_count++;
+}
+
+// at the outermost call, runs the dispatcher if a wakeup (or requestResched()) wants it to
+void preemptEnable() {
+    if (--preempt_count == 0) reschedIfNeeded();
+}
+
+// marks the start and end of an interrupt handler
+void interruptEnter() { preemptDisable(); }
+void interruptExit()  { preemptEnable();  }
+
+// asks for a dispatcher call at the next preemption point, e.g. because a quantum may be up
+void requestResched() {
+    need_resched = 1;
+}
+
+// a preemption point: runs the dispatcher if need_resched is set
+// syscall handlers call this before returning
+void reschedIfNeeded() {
+    if (need_resched && !preempt_count) {
+        // disable interrupts, save old interrupt state, check for kernel mode
+        unsigned int old_psr = check_and_disable(__func__);
+        dispatcher();
+        restore_interrupts(old_psr);
+    }
+}
+
+// wakes up a blocked process and reinstates it onto the priority queues
+// the awoken process may or may not run depending on the decision of the dispatcher
+int unblockProc(int pid) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    // retrieve a reference to the desired process
+    pcb * proc_toUnblock = get_proc(pid);
+
+    // perform error checking, and wake the process
+    if (!proc_toUnblock || wake_proc(proc_toUnblock) == -2) {
+        restore_interrupts(old_psr);
+        return -2;
+    }
+
+    // call the dispatcher to see if the awoken process needs to be switched to 
+    wake_dispatch();
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// wake_proc() for one of a batch of wakeups that ends in a single dispatcher() call
+// returns -2 if the process is not blocked
+static int wake_batched(pcb *proc) {
+    if (wake_proc(proc) == -2) return -2;
+
+    // unblockProc() would have preempted us for this one, putting us behind our peers;
+    // do that part now, so the run queue order matches a series of unblockProc() calls
+    if (proc->priority < cur_proc->priority && cur_proc->on_runq) {
+        dequeue_proc();
+        enqueue_proc(cur_proc->pid);
+        cur_requeued = 1;
+    }
+    return 0;
+}
+
+// ends a batch of wakeups, made with preemption disabled: one scheduling decision for all of them
+// (and for any wakeup an interrupt made meanwhile)
+static void wake_batch_end(int unblocked) {
+    unsigned int old_psr = check_and_disable(__func__);
+
+    preempt_count--;
+    if (unblocked) wake_dispatch();
+    else           reschedIfNeeded();
+    cur_requeued = 0;
+
+    restore_interrupts(old_psr);
+}
+
+// wakes up a batch of blocked processes, then calls the dispatcher once
+// interrupts are only disabled for one wakeup at a time
+// pids that are not blocked processes are skipped
+// returns the number of processes woken
+int unblockProcs(int *pids, int n) {
+    check_kernel_mode(__func__);
+    preemptDisable();
+
+    int woken = 0;
+    for (int i = 0; i < n; i++) {
+        unsigned int old_psr = check_and_disable(__func__);
+        pcb *proc = get_proc(pids[i]);
+        if (proc && wake_batched(proc) == 0) woken++;
+        restore_interrupts(old_psr);
+    }
+
+    wake_batch_end(woken);
+    return woken;
+}
+
+
+/*
+ * wait queues
+ *
+ * a process is WAIT_QUEUED from waitQueueAdd() until a wake call takes it off
+ * the queue, then WAIT_WOKEN until waitQueueBlock() returns.  a wake call only
+ * unblocks processes that are in waitQueueBlock(); one that has not got there
+ * yet (it may be blocked on something else, like a mutex) just finds itself
+ * WAIT_WOKEN when it does
+ */
+
+#define WAIT_NONE   0
+#define WAIT_QUEUED 1
+#define WAIT_WOKEN  2
+
+// takes the first process off wq and hands it value
+// returns the process, or NULL if wq is empty
+static pcb * wait_pop(WaitQueue *wq, int value) {
+    pcb *proc = wq->head;
+    if (!proc) return NULL;
+
+    wq->head = proc->next_wait;
+    if (!wq->head) wq->tail = NULL;
+    wq->count--;
+
+    proc->next_wait  = NULL;
+    proc->wait_value = value;
+    proc->wait_state = WAIT_WOKEN;
+    return proc;
+}
+
+void waitQueueInit(WaitQueue *wq) {
+    memset(wq, 0, sizeof(WaitQueue));
+}
+
+// puts the current process at the back of wq, without blocking it
+// data is what waitQueuePeek() returns while this process is first in line
+void waitQueueAdd(WaitQueue *wq, void *data) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    wait_add(wq, data);
+
+    restore_interrupts(old_psr);
+}
+
+// waitQueueAdd(), for callers that already have interrupts disabled
+static void wait_add(WaitQueue *wq, void *data) {
+    if (cur_proc->wait_state != WAIT_NONE) {
+        USLOSS_Console("ERROR: Process %d called waitQueueAdd() while already on a wait queue.\n", cur_proc->pid);
+        USLOSS_Halt(1);
+    }
+
+    cur_proc->next_wait  = NULL;
+    cur_proc->wait_data  = data;
+    cur_proc->wait_value = 0;
+    cur_proc->wait_state = WAIT_QUEUED;
+
+    if (wq->tail) ((pcb *)wq->tail)->next_wait = cur_proc;
+    else          wq->head = cur_proc;
+    wq->tail = cur_proc;
+    wq->count++;
+}
+
+// blocks the current process until a wake call takes it off its wait queue
+// returns the value passed to the wake call
+int waitQueueBlock() {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    int value = wait_block();
+
+    restore_interrupts(old_psr);
+    return value;
+}
+
+// waitQueueBlock(), for callers that already have interrupts disabled
+static int wait_block() {
+    if (cur_proc->wait_state == WAIT_NONE) {
+        USLOSS_Console("ERROR: Process %d called waitQueueBlock() without calling waitQueueAdd().\n", cur_proc->pid);
+        USLOSS_Halt(1);
+    }
+
+    // an unblockProc() from someone else would wake us early, so block again until it's a wake call
+    while (cur_proc->wait_state == WAIT_QUEUED) {
+        cur_proc->in_wait = 1;
+        block_cur();
+        cur_proc->in_wait = 0;
+    }
+    cur_proc->wait_state = WAIT_NONE;
+    return cur_proc->wait_value;
+}
+
+int waitQueueSleep(WaitQueue *wq, void *data) {
+    waitQueueAdd(wq, data);
+    return waitQueueBlock();
+}
+
+// returns the data the first process on wq passed to waitQueueAdd(), or NULL if wq is empty
+void * waitQueuePeek(WaitQueue *wq) {
+    return wq->head ? ((pcb *)wq->head)->wait_data : NULL;
+}
+
+// moves every process on src to the back of dst, leaving src empty
+void waitQueueSplice(WaitQueue *dst, WaitQueue *src) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    if (src->head) {
+        if (dst->tail) ((pcb *)dst->tail)->next_wait = src->head;
+        else           dst->head = src->head;
+        dst->tail   = src->tail;
+        dst->count += src->count;
+        waitQueueInit(src);
+    }
+
+    restore_interrupts(old_psr);
+}
+
+int waitQueueWakeOne(WaitQueue *wq) {
+    return waitQueueWakeValue(wq, 0);
+}
+
+// wakes the first process on wq, which gets value back from waitQueueBlock()
+// returns the number of processes woken
+int waitQueueWakeValue(WaitQueue *wq, int value) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    int woken = wait_wake(wq, value);
+
+    restore_interrupts(old_psr);
+    return woken;
+}
+
+// waitQueueWakeValue(), for callers that already have interrupts disabled
+static int wait_wake(WaitQueue *wq, int value) {
+    pcb *proc = wait_pop(wq, value);
+
+    // like unblockProc(), let the dispatcher decide whether it runs now
+    if (proc && proc->in_wait && wake_proc(proc) == 0) wake_dispatch();
+
+    return proc != NULL;
+}
+
+// wakes every process on wq, in order, then calls the dispatcher once
+// interrupts are only disabled for one wakeup at a time
+// each of them gets value back from waitQueueBlock()
+// returns the number of processes woken
+int waitQueueWakeAll(WaitQueue *wq, int value) {
+    check_kernel_mode(__func__);
+    preemptDisable();
+
+    int woken = 0, unblocked = 0;
+    for (;;) {
+        unsigned int old_psr = check_and_disable(__func__);
+        pcb *proc = wait_pop(wq, value);
+        if (proc && proc->in_wait && wake_batched(proc) == 0) unblocked++;
+        restore_interrupts(old_psr);
+
+        if (!proc) break;
+        woken++;
+    }
+
+    wake_batch_end(unblocked);
+    return woken;
+}
+
+
+/*
+ * worker pools
+ *
+ * the workers are ordinary children of the process that made the pool.
+ * between tasks they sleep on pool->idle, so a task reuses the worker's
+ * pcb, stack and context, and costs one wakeup to start
+ */
+
+// starts nworkers workers, with the given stack size and priority
+// returns NULL if the arguments are bad, or a worker could not be started
+WorkerPool * poolCreate(char *name, int nworkers, int stacksize, int priority) {
+    if (nworkers < 1) return NULL;
+
+    WorkerPool *pool = calloc(1, sizeof(WorkerPool));
+    int        *pids = malloc(nworkers * sizeof(int));
+    if (!pool || !pids) {
+        free(pool);
+        free(pids);
+        return NULL;
+    }
+    pool->pids     = pids;
+    pool->nworkers = nworkers;
+
+    for (int i = 0; i < nworkers; i++) {
+        pids[i] = spork(name, pool_worker, pool, stacksize, priority);
+        if (pids[i] < 0) {
+            pool_close(pool, i);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+// interrupts stay disabled except while a task runs
+static int pool_worker(void *arg) {
+    WorkerPool  *pool    = arg;
+    unsigned int old_psr = check_and_disable(__func__);
+
+    while (1) {
+        // wait for a task, unless the pool is being torn down
+        while (!pool->pending_head && !pool->closing) {
+            wait_add(&pool->idle, NULL);
+            wait_block();
+        }
+
+        pool_task *task = pool->pending_head;
+        if (!task) break;
+        pool->pending_head = task->next;
+        if (!pool->pending_head) pool->pending_tail = NULL;
+
+        restore_interrupts(old_psr);
+        int result = task->func(task->arg);
+        disable_interrupts();
+
+        task->result = result;
+        task->next   = NULL;
+        if (pool->done_tail) pool->done_tail->next = task;
+        else                 pool->done_head       = task;
+        pool->done_tail = task;
+        wait_wake(&pool->collectors, 0);
+    }
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// stops the first nworkers workers, joins them, and frees the pool
+static void pool_close(WorkerPool *pool, int nworkers) {
+    int status;
+
+    pool->closing = 1;
+    waitQueueWakeAll(&pool->idle, 0);
+    for (int i = 0; i < nworkers; i++)
+        joinPid(pool->pids[i], &status);
+
+    while (pool->free_tasks) {
+        pool_task *task  = pool->free_tasks;
+        pool->free_tasks = task->next;
+        free(task);
+    }
+    free(pool->pids);
+    free(pool);
+}
+
+// queues func(arg) for the next free worker
+// returns the task's ticket, or -1 if the arguments are bad
+int poolSubmit(WorkerPool *pool, int (*func)(void *), void *arg) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    if (!pool || !func || pool->closing) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    pool_task *task = pool->free_tasks;
+    if (task) {
+        pool->free_tasks = task->next;
+    } else if (!(task = malloc(sizeof(pool_task)))) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    task->next   = NULL;
+    task->func   = func;
+    task->arg    = arg;
+    task->ticket = pool->next_ticket++;
+    if (pool->pending_tail) pool->pending_tail->next = task;
+    else                    pool->pending_head       = task;
+    pool->pending_tail = task;
+    pool->outstanding++;
+
+    // a busy worker will get to it if none is idle
+    int ticket = task->ticket;
+    wait_wake(&pool->idle, 0);
+
+    restore_interrupts(old_psr);
+    return ticket;
+}
+
+// waits for a task to finish, and stores what it returned in result
+// returns the task's ticket, or -1 if no task is outstanding
+int poolCollect(WorkerPool *pool, int *result) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    if (!pool || !pool->outstanding) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+    pool->outstanding--;
+
+    while (!pool->done_head) {
+        wait_add(&pool->collectors, NULL);
+        wait_block();
+    }
+
+    pool_task *task = pool->done_head;
+    pool->done_head = task->next;
+    if (!pool->done_head) pool->done_tail = NULL;
+
+    if (result) *result = task->result;
+    int ticket = task->ticket;
+
+    task->next       = pool->free_tasks;
+    pool->free_tasks = task;
+
+    restore_interrupts(old_psr);
+    return ticket;
+}
+
+// stops and joins the workers, and frees the pool
+// returns -1 if tasks are still outstanding, or the caller did not create the pool
+int poolDestroy(WorkerPool *pool) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    pcb *worker = pool ? get_proc(pool->pids[0]) : NULL;
+    if (!pool || pool->outstanding || !worker || worker->parent != cur_proc) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    pool_close(pool, pool->nworkers);
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+
+/*
+ * kernel work queues
+ *
+ * like a worker pool, but the caller owns the work items, and nothing is handed
+ * back, so queueWork() needs no memory and never blocks: it is safe in an
+ * interrupt handler.  the wakeup it makes there is dispatched by interruptExit()
+ */
+
+void workInit(WorkItem *work, void (*func)(void *), void *arg) {
+    memset(work, 0, sizeof(WorkItem));
+    work->func = func;
+    work->arg  = arg;
+}
+
+// starts nworkers workers, with the given stack size and priority
+// returns NULL if the arguments are bad, or a worker could not be started
+WorkQueue * workQueueCreate(char *name, int nworkers, int stacksize, int priority) {
+    if (nworkers < 1) return NULL;
+
+    WorkQueue *wq   = calloc(1, sizeof(WorkQueue));
+    int       *pids = malloc(nworkers * sizeof(int));
+    if (!wq || !pids) {
+        free(wq);
+        free(pids);
+        return NULL;
+    }
+    wq->pids     = pids;
+    wq->nworkers = nworkers;
+
+    for (int i = 0; i < nworkers; i++) {
+        pids[i] = spork(name, work_worker, wq, stacksize, priority);
+        if (pids[i] < 0) {
+            work_close(wq, i);
+            return NULL;
+        }
     }
+    return wq;
+}
+
+// interrupts stay disabled except while an item runs
+static int work_worker(void *arg) {
+    WorkQueue   *wq      = arg;
+    unsigned int old_psr = check_and_disable(__func__);
+
+    while (1) {
+        // wait for an item, unless the queue is being torn down
+        while (!wq->head && !wq->closing) {
+            wait_add(&wq->idle, NULL);
+            wait_block();
+        }
+
+        WorkItem *work = wq->head;
+        if (!work) break;
+        wq->head = work->next;
+        if (!wq->head) wq->tail = NULL;
+
+        // off the queue before it runs, so it can be queued again from here on
+        work->next    = NULL;
+        work->pending = 0;
+        wq->busy++;
+
+        restore_interrupts(old_psr);
+        work->func(work->arg);
+        disable_interrupts();
+
+        // the last worker to go idle on an empty queue lets the flushers go
+        if (--wq->busy == 0 && !wq->head)
+            while (wait_wake(&wq->flushers, 0));
+    }
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// stops the first nworkers workers, joins them, and frees the work queue
+static void work_close(WorkQueue *wq, int nworkers) {
+    int status;
+
+    wq->closing = 1;
+    waitQueueWakeAll(&wq->idle, 0);
+    for (int i = 0; i < nworkers; i++)
+        joinPid(wq->pids[i], &status);
+
+    free(wq->pids);
+    free(wq);
+}
+
+// queues work for the next free worker, unless it is queued already
+// returns 1 if it was queued, 0 if it already was, or -1 if the arguments are bad
+int queueWork(WorkQueue *wq, WorkItem *work) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    if (!wq || !work || !work->func || wq->closing) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+    if (work->pending) {
+        restore_interrupts(old_psr);
+        return 0;
+    }
+
+    work->next    = NULL;
+    work->pending = 1;
+    if (wq->tail) wq->tail->next = work;
+    else          wq->head       = work;
+    wq->tail = work;
+
+    // a busy worker will get to it if none is idle
+    wait_wake(&wq->idle, 0);
 
     restore_interrupts(old_psr);
+    return 1;
+}
+
+// waits until nothing is queued and no worker is running an item
+void workQueueFlush(WorkQueue *wq) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    while (wq && (wq->head || wq->busy)) {
+        wait_add(&wq->flushers, NULL);
+        wait_block();
+    }
+
+    restore_interrupts(old_psr);
+}
+
+// lets the workers finish what is queued, then stops and joins them, and frees the work queue
+// returns -1 if the caller did not create the work queue
+int workQueueDestroy(WorkQueue *wq) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    pcb *worker = wq ? get_proc(wq->pids[0]) : NULL;
+    if (!wq || !worker || worker->parent != cur_proc) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    work_close(wq, wq->nworkers);
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// deciphers which process is at the head of the highest non-empty priority queue
+// this process may or may not be the active process
+// depending on the current process (and how long it has been active), a context switch may 
+// turn on the chosen process, turn off the chosen process, or do nothing if the chosen process
+// has not been running for its promised time
+void dispatcher() {
+
+    unsigned int old_psr = check_and_disable(__func__);
+
+    // this is the scheduling decision a wakeup may have asked for
+    need_resched = 0;
+
+    // charge the current process for the CPU it has used since it was last charged
+    int now = currentTime();
+    if (cur_proc != &boot_proc) sched->tick(cur_proc, now - time_ofLastCharge);
+    time_ofLastCharge = now;
+
+    // choose which process will run next
+    // if nothing is runnable, wait for an interrupt to wake something up
+    pcb * proc_toRun;
+    while (!(proc_toRun = runq_pick())) {
+        acct_charge(now);
+        enable_interrupts();
+        USLOSS_WaitInt();
+        disable_interrupts();
+        now = time_ofLastCharge = time_ofLastRun = currentTime();
+    }
+
+    // if the same process is still the scheduler's choice
+    if (proc_toRun == cur_proc) {
+        int elapsed = (now - time_ofLastSwitch)/1000;
+
+        // if the current process has used up its quantum, requeue it behind its peers and choose again
+        if (elapsed >= sched->quantum_for(cur_proc)) {
+            dequeue_proc();
+            enqueue_proc(cur_proc->pid);
+            time_ofLastSwitch = now;
+            proc_toRun = runq_pick();
+        }
+        if (proc_toRun == cur_proc) {
+            restore_interrupts(old_psr);
+            return;
+        }
+    }
+
+    // there is a new process that needs to run; the current one goes behind its peers
+    if (!cur_requeued) {
+        dequeue_proc();
+        enqueue_proc(cur_proc->pid);
+    }
+    cur_requeued = 0;
+    USLOSS_Context *old = &cur_proc->cold->context;
+    USLOSS_Context *new = &proc_toRun->cold->context;
+
+    // charge the current process for its time on the CPU, and count the switch
+    acct_charge(now);
+    if (cur_proc->is_blocked || cur_proc->termination) cur_proc->cold->acct.vol_switches++;
+    else                                                cur_proc->cold->acct.invol_switches++;
+
+    int waited = now - proc_toRun->runq_since;
+    if (waited > max_runq_wait[proc_toRun->priority]) max_runq_wait[proc_toRun->priority] = waited;
+    if (tracing) trace_dispatch(proc_toRun, now);
+    proc_toRun->trace_woken = 0;
+
+    // update current process global
+    cur_proc = proc_toRun;
+    time_ofLastSwitch = now;
+    // perform the context switch
+    USLOSS_ContextSwitch(old, new);
+
+    restore_interrupts(old_psr);
+}
+
+// sets the most processes that may exist at once (default MAXPROC)
+// the process table grows in MAXPROC-sized chunks as needed to reach it
+// returns -1 if max is below the number of processes that already exist
+int setMaxProcs(int max) {
+    check_kernel_mode(__func__);
+    if (max < 1 || max < num_procs) return -1;
+    max_procs = max;
+    return 0;
+}
+
+// returns the process table index of the given process, or -1 if there is no such process
+// the index is below the most processes that have ever existed at once, and does not
+// change while the process exists, so other phases can use it to index per-process data
+int procSlot(int pid) {
+    pcb *proc = get_proc(pid);
+    return proc ? proc->slot : -1;
+}
+
+// sets the quantum of the priority scheduler
+// returns the old quantum, or -1 if ms is less than 1
+int setQuantum(int ms) {
+    if (ms < 1) return -1;
+
+    int old = prio_quantum;
+    prio_quantum = ms;
+    return old;
+}
+
+// sets how long a process waits on a run queue of the priority scheduler before it moves up one
+// 0 turns aging off; returns the old setting, or -1 if ms is negative
+int setAging(int ms) {
+    if (ms < 0) return -1;
+
+    int old = aging_ms;
+    aging_ms = ms;
+    return old;
+}
+
+// returns the longest time, in us, that a process of the given priority has waited on a run queue
+// to be switched to, or -1 if the priority is out of range
+int getMaxRunqWait(int priority) {
+    if (priority < 1 || priority > 6) return -1;
+    return max_runq_wait[priority];
+}
+
+
+/*
+ * scheduling trace
+ *
+ * while tracing, the scheduler events go into a ring that keeps the last trace_size of them,
+ * each stamped with a clock read of its own.  every switch to a process also goes into two
+ * latency histograms for its priority: runnable-to-run (from its last enqueue) always, and
+ * wakeup-to-run too if a wakeup is what made it runnable.  bucket 0 is 0us, and bucket i holds
+ * [2^(i-1), 2^i) us; the last bucket also holds everything longer
+ */
+
+typedef struct latency_hist {
+    long count;
+    int  max;
+    long buckets[LAT_BUCKETS];
+} latency_hist;
+
+static TraceEvent  *trace_buf;              // the ring, trace_size events
+static int          trace_size;
+static long         trace_count;            // events recorded since traceStart(); the next goes in count % size
+static latency_hist wakeup_lat[7];          // by priority
+static latency_hist runnable_lat[7];
+
+// records an event for proc, at the current time
+// returns the time
+static int trace_event(int type, pcb *proc) {
+    int now = currentTime();
+    trace_put(type, proc, now);
+    return now;
+}
+
+static void trace_put(int type, pcb *proc, int time) {
+    TraceEvent *event = &trace_buf[trace_count++ % trace_size];
+    event->time     = time;
+    event->pid      = proc->pid;
+    event->priority = proc->priority;
+    event->type     = type;
+}
+
+static void hist_add(latency_hist *hist, int us) {
+    if (us < 0) us = 0;
+
+    int bucket = 0;
+    while (us >> bucket && bucket < LAT_BUCKETS - 1) bucket++;
+
+    hist->count++;
+    hist->buckets[bucket]++;
+    if (us > hist->max) hist->max = us;
+}
+
+// records the switch to proc, at now
+static void trace_dispatch(pcb *proc, int now) {
+    trace_put(TRACE_DISPATCH, proc, now);
+    hist_add(&runnable_lat[proc->priority], now - proc->runq_since);
+    if (proc->trace_woken) hist_add(&wakeup_lat[proc->priority], now - proc->runq_since);
+}
+
+// starts recording scheduler events, keeping the last nevents of them, and clears the histograms
+// returns -1 if nevents is less than 1 or there is no memory for the ring
+int traceStart(int nevents) {
+    check_kernel_mode(__func__);
+    if (nevents < 1) return -1;
+
+    TraceEvent *buf = malloc(nevents * sizeof(TraceEvent));
+    if (!buf) return -1;
+
+    unsigned int old_psr = check_and_disable(__func__);
+    free(trace_buf);
+    trace_buf   = buf;
+    trace_size  = nevents;
+    trace_count = 0;
+    memset(wakeup_lat,   0, sizeof(wakeup_lat));
+    memset(runnable_lat, 0, sizeof(runnable_lat));
+    tracing = 1;
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// stops recording; the ring and the histograms are kept for reading
+void traceStop() {
+    tracing = 0;
+}
+
+// copies up to max of the events in the ring to events, oldest first
+// returns the number copied
+int traceRead(TraceEvent *events, int max) {
+    unsigned int old_psr = check_and_disable(__func__);
+
+    long first = trace_count > trace_size ? trace_count - trace_size : 0;
+    int  n     = 0;
+    for (long i = first; i < trace_count && n < max; i++)
+        events[n++] = trace_buf[i % trace_size];
+
+    restore_interrupts(old_psr);
+    return n;
+}
+
+// the smallest bucket bound at or below which the given fraction (in percent) of hist falls,
+// capped at the largest value seen
+static int hist_percentile(latency_hist *hist, int percent) {
+    long want = (hist->count * percent + 99) / 100, seen = 0;
+    for (int i = 0; i < LAT_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= want) {
+            int bound = i ? (1 << i) - 1 : 0;
+            return bound < hist->max ? bound : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static void hist_stats(latency_hist *hist, LatencyStats *stats) {
+    stats->count = hist->count;
+    stats->max   = hist->max;
+    stats->p50   = hist_percentile(hist, 50);
+    stats->p99   = hist_percentile(hist, 99);
+    memcpy(stats->buckets, hist->buckets, sizeof(stats->buckets));
+}
+
+// fills in the latency statistics for processes of the given priority, since traceStart()
+// returns -1 if the priority is out of range
+int getSchedLatency(int priority, LatencyStats *wakeup, LatencyStats *runnable) {
+    if (priority < 1 || priority > 6) return -1;
+
+    unsigned int old_psr = check_and_disable(__func__);
+    hist_stats(&wakeup_lat[priority],   wakeup);
+    hist_stats(&runnable_lat[priority], runnable);
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// prints the latency statistics and histograms for every priority that has any
+void dumpSchedLatency() {
+    USLOSS_Console("PRIO  FROM        COUNT       P50       P99       MAX  (us)\n");
+    for (int prio = 1; prio <= 6; prio++) {
+        LatencyStats stats[2];
+        getSchedLatency(prio, &stats[0], &stats[1]);
+
+        for (int kind = 0; kind < 2; kind++) {
+            LatencyStats *st = &stats[kind];
+            if (!st->count) continue;
+
+            USLOSS_Console("%4d  %-8s  %7ld  %8d  %8d  %8d\n", prio, kind ? "runnable" : "wakeup",
+                           st->count, st->p50, st->p99, st->max);
+            USLOSS_Console("      ");
+            for (int i = 0; i < LAT_BUCKETS; i++) {
+                if (st->buckets[i])
+                    USLOSS_Console(" <%d:%ld", i ? 1 << i : 1, st->buckets[i]);
+            }
+            USLOSS_Console("\n");
+        }
+    }
+}
+
+
+/*
+ * accounting
+ */
+
+// charges cur_proc for the CPU it has used since time_ofLastRun, and restarts the count at now
+static void acct_charge(int now) {
+    cur_proc->cold->acct.cpu_us += now - time_ofLastRun;
+    time_ofLastRun = now;
+}
+
+// counts a syscall made by the current process
+void accountSyscall() {
+    cur_proc->cold->acct.syscalls++;
+}
+
+// counts bytes of I/O done for the current process; kind is one of the ACCT_ constants
+void accountIO(int kind, int bytes) {
+    if (kind < 0 || kind >= ACCT_KINDS) return;
+    cur_proc->cold->acct.io_bytes[kind] += bytes;
+}
+
+// fills in info for the process with the given pid
+// returns -1 if there is no such process
+int getProcInfo(int pid, ProcInfo *info) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    pcb *proc = get_proc(pid);
+    if (!proc || !proc->is_alive) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    proc_acct *acct = &proc->cold->acct;
+    info->pid      = proc->pid;
+    info->ppid     = proc->parent ? proc->parent->pid : 0;
+    info->priority = proc->priority;
+    info->level    = sched == &sched_mlfq ? mlfq_level(proc) : proc->priority - 1;
+    snprintf(info->name, sizeof(info->name), "%s", proc->cold->name);
+    info->state    = proc == cur_proc   ? PROC_RUNNING   :
+                     proc->termination  ? PROC_QUIT      :
+                     proc->is_blocked   ? PROC_BLOCKED   : PROC_RUNNABLE;
+
+    // the running process gets its current stretch on the CPU too
+    info->cpu_us         = acct->cpu_us;
+    if (proc == cur_proc) info->cpu_us += currentTime() - time_ofLastRun;
+    info->vol_switches   = acct->vol_switches;
+    info->invol_switches = acct->invol_switches;
+    info->syscalls       = acct->syscalls;
+    memcpy(info->io_bytes, acct->io_bytes, sizeof(info->io_bytes));
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// for dumpTop(): most CPU first
+static int cmp_cpu(const void *a, const void *b) {
+    const ProcInfo *pa = a, *pb = b;
+    if (pa->cpu_us != pb->cpu_us) return pa->cpu_us < pb->cpu_us ? 1 : -1;
+    return pa->pid - pb->pid;
+}
+
+// prints every process's accounting, the biggest CPU users first
+// interrupts are only disabled while each process's info is copied out
+void dumpTop() {
+    check_kernel_mode(__func__);
+    preemptDisable();
+
+    int       n     = 0;
+    ProcInfo *infos = malloc(pid_map_size * sizeof(ProcInfo));
+    for (int i = 0; infos && i < pid_map_size; i++) {
+        pcb *proc = pid_map[i];
+        if (proc && getProcInfo(proc->pid, &infos[n]) == 0) n++;
+    }
+    qsort(infos, n, sizeof(ProcInfo), cmp_cpu);
+
+    static const char states[] = "RrBQ";  // running, runnable, blocked, quit
+    USLOSS_Console(" PID  PPID  %-16s  PRI  S     CPU(ms)   VOL  INVOL  SYSCALLS    DISK_RD    DISK_WR    TERM_RD    TERM_WR\n", "NAME");
+    for (int i = 0; i < n; i++) {
+        ProcInfo *info = &infos[i];
+        USLOSS_Console("%4d  %4d  %-16s  %3d  %c  %10lld  %4ld  %5ld  %8ld  %9ld  %9ld  %9ld  %9ld\n",
+                info->pid, info->ppid, info->name, info->priority, states[info->state],
+                info->cpu_us / 1000, info->vol_switches, info->invol_switches, info->syscalls,
+                info->io_bytes[ACCT_DISK_READ], info->io_bytes[ACCT_DISK_WRITE],
+                info->io_bytes[ACCT_TERM_READ], info->io_bytes[ACCT_TERM_WRITE]);
+    }
+    free(infos);
+
+    preemptEnable();
+}
+
+// reserves size bytes (rounded up to keep pointers aligned) of every process's data
+// returns the key to pass to procData(), or -1 if there isn't room
+int procDataRegister(int size) {
+    size = (size + 7) & ~7;
+    if (size < 0 || size > PROC_DATA_SIZE - proc_data_used) return -1;
+
+    int key = proc_data_used;
+    proc_data_used += size;
+    return key;
+}
+
+// the current process's data for key
+void * procData(int key) {
+    return cur_proc->data + key;
 }
 
 // returns the pid of the current running process
@@ -632,11 +2602,18 @@ int getpid() {
 // prints out the contents of the priority queues
 // (for debugging)
 void dumpQueues() {
+    USLOSS_Console("Scheduler: %s\n", sched->name);
+    if (sched == &sched_stride) {
+        USLOSS_Console("Stride heap: ");
+        for (int i = 0; i < stride_count; i++)
+            USLOSS_Console(" ( %s : %d : %lld ) ", stride_heap[i]->cold->name, stride_heap[i]->pid, stride_heap[i]->sched_pass);
+        USLOSS_Console("\n");
+    }
     for (int i=0; i < 6; i++) {
-        pcb *cur = queues[i];
+        pcb *cur = queues[i].head;
         USLOSS_Console("Queue %d: ", i+1);
         while (cur) {
-            USLOSS_Console(" ( %s : %d ) ", cur->name, cur->pid);
+            USLOSS_Console(" ( %s : %d ) ", cur->cold->name, cur->pid);
             cur = cur->next_run;
         }
         USLOSS_Console("\n");
@@ -649,42 +2626,65 @@ void dumpChildren() {
     pcb *cur = cur_proc->first_child;
     int i = 1;
     while (cur) {
-        USLOSS_Console("child %d.     %s : %d\n", i, cur->name, cur->pid);
+        USLOSS_Console("child %d.     %s : %d\n", i, cur->cold->name, cur->pid);
         cur = cur->next_sibling;
         i++;
     }
 }
 
 // prints out a list of all processes in the proc table
+// interrupts are disabled while a row is copied out, not while it is printed; preemption stays
+// disabled throughout, so no other process can change the table meanwhile
 void dumpProcesses() {
-    // disable interrupts, save old interrupt state, check for kernel mode
-    unsigned int old_psr = check_and_disable(__func__);
+    check_kernel_mode(__func__);
+    preemptDisable();
 
     USLOSS_Console(" PID  PPID  %-*s  PRIORITY  STATE\n", 16, "NAME");
-    for (int i = 0; i < MAXPROC; i++) {
-        pcb * proc = get_proc(i);
-        if (proc->is_alive) {
-            // retrieve the ppid
-            int ppid = proc->parent      ? proc->parent->pid      : 0;
-
-            // ascertain the status of the process
-            char status_to_print[100];
-            if      (proc == cur_proc)  strcpy(status_to_print, "Running");
-            else if (proc->is_blocked && proc->in_zap)  strcpy(status_to_print, "Blocked(waiting for zap target to quit)");
-            else if (proc->is_blocked && proc->in_join)  strcpy(status_to_print, "Blocked(waiting for child to quit)");
-            else if (proc->is_blocked)  strcpy(status_to_print, "Blocked(3)");
-            else if (proc->status == 0) strcpy(status_to_print, "Runnable");
-            else                        snprintf(status_to_print, sizeof(status_to_print), "Terminated(%d)", proc->status);
-
-            // print process information to console
-            USLOSS_Console(" %*d  %*d  %-*s  %-*d  %s\n",
-                    3, proc->pid,
-                    4, ppid,
-                    16, proc->name,
-                    8, proc->priority,
-                    status_to_print);
+    for (int i = 0; i < pid_map_size; i++) {
+        // disable interrupts, save old interrupt state, check for kernel mode
+        unsigned int old_psr = check_and_disable(__func__);
+
+        pcb * proc = pid_map[i];
+        if (!proc || !proc->is_alive) {
+            restore_interrupts(old_psr);
+            continue;
         }
+
+        // retrieve the ppid
+        int ppid = proc->parent      ? proc->parent->pid      : 0;
+
+        // ascertain the status of the process
+        char status_to_print[100];
+        if      (proc == cur_proc)  strcpy(status_to_print, "Running");
+        else if (proc->is_blocked && proc->in_zap)  strcpy(status_to_print, "Blocked(waiting for zap target to quit)");
+        else if (proc->is_blocked && proc->in_join)  strcpy(status_to_print, "Blocked(waiting for child to quit)");
+        else if (proc->is_blocked)  strcpy(status_to_print, "Blocked(3)");
+        else if (proc->status == 0) strcpy(status_to_print, "Runnable");
+        else                        snprintf(status_to_print, sizeof(status_to_print), "Terminated(%d)", proc->status);
+
+        int   pid      = proc->pid;
+        char *name     = proc->cold->name;
+        int   priority = proc->priority;
+        restore_interrupts(old_psr);
+
+        // print process information to console
+        USLOSS_Console(" %*d  %*d  %-*s  %-*d  %s\n",
+                3, pid,
+                4, ppid,
+                16, name,
+                8, priority,
+                status_to_print);
     }
-    restore_interrupts(old_psr);
+
+    preemptEnable();
 }
 
+
+// reads the current time from the clock device
+// later phases may provide their own
+int __attribute__((weak)) currentTime() {
+    int retval;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &retval);
+    (void)rc;
+    return retval;
+}
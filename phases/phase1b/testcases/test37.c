@@ -0,0 +1,71 @@
+/*
+ * Check that the process table grows past MAXPROC.
+ * Raise the limit to 10000 processes, and start children (without
+ * calling join() on any of them) until spork() fails.  init and
+ * testcase_main occupy two of the slots, so 9998 new processes will
+ * start.  Then join() all of them, and start one more to check that
+ * the freed slots are reused.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+#define NUM_PROCS 10000
+
+int XXp1(void *);
+
+int testcase_main()
+{
+    int i, pid1, started = 0, joined = 0, bad_status = 0, max_slot = 0;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: Raise the process limit to %d, then create processes until spork() fails.  %d should start, and all of them should be joined.\n", NUM_PROCS, NUM_PROCS-2);
+
+    if (setMaxProcs(1) != -1)
+        USLOSS_Console("testcase_main(): setMaxProcs() below the number of live processes should have failed.\n");
+
+    USLOSS_Console("testcase_main(): setMaxProcs(%d) returned %d\n", NUM_PROCS, setMaxProcs(NUM_PROCS));
+
+    for (i = 0; i < NUM_PROCS; i++)
+    {
+        pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+        if (pid1 < 0)
+        {
+            USLOSS_Console("testcase_main(): spork() failed: i=%d, pid is %d.\n", i,pid1);
+            break;
+        }
+        if (procSlot(pid1) > max_slot)
+            max_slot = procSlot(pid1);
+        started++;
+    }
+
+    USLOSS_Console("testcase_main(): started %d processes, highest slot %d\n", started, max_slot);
+
+    for (i = 0; i < started; i++)
+    {
+        int status;
+        pid1 = join(&status);
+        if (pid1 < 0)
+            USLOSS_Console("testcase_main(): join() failed: i=%d, pid is %d.\n", i,pid1);
+        else
+        {
+            joined++;
+            if (status != pid1 % 100)
+                bad_status++;
+        }
+    }
+
+    USLOSS_Console("testcase_main(): joined %d processes, %d with the wrong status\n", joined, bad_status);
+
+    pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): after the joins, spork() returned %d, in slot %d\n", pid1, procSlot(pid1));
+    join(&i);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    quit(getpid() % 100);
+}
@@ -0,0 +1,55 @@
+/*
+ * Check that join() returns stacks to the pool, and spork() reuses them.
+ * testcase_main and the first child each need a new stack.  After that,
+ * every child should get the stack the previous child left behind.  A
+ * child with a bigger stack falls in a different size class, so it
+ * needs a new stack too.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+static void printStats(char *when)
+{
+    StackPoolStats stats;
+
+    getStackPoolStats(&stats);
+    USLOSS_Console("testcase_main(): %s: hits %ld misses %ld releases %ld evictions %ld cached %ldK mapped %ldK\n",
+                   when, stats.hits, stats.misses, stats.releases, stats.evictions,
+                   stats.bytes_cached / 1024, stats.bytes_mapped / 1024);
+}
+
+int testcase_main()
+{
+    int i, pid1, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: 100 children are created and joined one at a time.  Only the first should need a new stack.  Then a child with twice the minimum stack needs one more.\n");
+
+    printStats("before");
+
+    for (i = 0; i < 100; i++)
+    {
+        pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+        if (pid1 < 0)
+            USLOSS_Console("testcase_main(): spork() failed: i=%d, pid is %d.\n", i,pid1);
+        join(&status);
+    }
+
+    printStats("after 100 children");
+
+    pid1 = spork("XXp1", XXp1, NULL, 2 * USLOSS_MIN_STACK, 2);
+    join(&status);
+
+    printStats("after a bigger child");
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    quit(3);
+}
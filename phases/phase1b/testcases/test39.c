@@ -0,0 +1,52 @@
+/*
+ * Check joinPid().
+ * testcase_main creates three lower-priority children, then waits on the
+ * middle one.  The first child quits before it, but must not wake
+ * testcase_main up.  join() then collects the other two.  Also checks
+ * joinPid() on a child that has already quit, and the error cases.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+int testcase_main()
+{
+    int pids[3], pid1, pid2, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: joinPid() returns the middle child even though the first one quit earlier; join() then returns the first child, then the last.\n");
+
+    pids[0] = spork("XXp1", XXp1, "XXp1_a", USLOSS_MIN_STACK, 4);
+    pids[1] = spork("XXp1", XXp1, "XXp1_b", USLOSS_MIN_STACK, 4);
+    pids[2] = spork("XXp1", XXp1, "XXp1_c", USLOSS_MIN_STACK, 4);
+    USLOSS_Console("testcase_main(): created children %d %d %d\n", pids[0], pids[1], pids[2]);
+
+    pid1 = joinPid(pids[1], &status);
+    USLOSS_Console("testcase_main(): joinPid(%d) returned %d, status %d\n", pids[1], pid1, status);
+
+    pid1 = join(&status);
+    USLOSS_Console("testcase_main(): join() returned %d, status %d\n", pid1, status);
+    pid1 = join(&status);
+    USLOSS_Console("testcase_main(): join() returned %d, status %d\n", pid1, status);
+
+    pid1 = spork("XXp1", XXp1, "XXp1_d", USLOSS_MIN_STACK, 2);
+    pid2 = joinPid(pid1, &status);
+    USLOSS_Console("testcase_main(): joinPid(%d) on a child that already quit returned %d, status %d\n", pid1, pid2, status);
+
+    USLOSS_Console("testcase_main(): joinPid(1) returned %d\n", joinPid(1, &status));
+    USLOSS_Console("testcase_main(): joinPid(%d) after it was joined returned %d\n", pid1, joinPid(pid1, &status));
+    pid1 = spork("XXp1", XXp1, "XXp1_e", USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): joinPid(%d, NULL) returned %d\n", pid1, joinPid(pid1, NULL));
+    join(&status);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("%s(): started, pid %d, quitting\n", (char *)arg, getpid());
+    quit(getpid() * 10);
+}
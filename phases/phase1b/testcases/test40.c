@@ -0,0 +1,119 @@
+/*
+ * Check setScheduler().
+ * An unknown policy is refused.  Then, under each policy in turn,
+ * testcase_main creates a higher-priority child (which runs to completion
+ * under any policy, since nothing else is runnable at its level) and a
+ * lower-priority child, and joins both.
+ *
+ * Then the policies themselves:
+ *   - mlfq: a CPU-bound child watches its own level.  It should sink one
+ *     level per quantum used, from 0 down to 4, and the next boost should
+ *     put it back on 0.
+ *   - stride: two CPU-bound children with 16 and 8 tickets spin side by
+ *     side for 600ms.  The first should get about twice the CPU.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+int Hog(void *);
+int Spinner(void *);
+
+static char      levels_seen[64];
+static int       spin_until;
+static long long spin_cpu[2];
+
+// burn about 0.1ms of CPU; the loops below only look at the clock between these,
+// since every clock read moves USLOSS time forward a little
+static void burn(void)
+{
+    for (volatile int i = 0; i < 100000; i++)
+        ;
+}
+
+int testcase_main()
+{
+    char *policies[] = { "mlfq", "stride", "priority" };
+    int   i, pid1, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: setScheduler(\"bogus\") fails; each real policy runs and joins two children.  Under mlfq a CPU hog sinks through levels 0-4 and a boost lifts it back to 0; under stride 16 tickets get about twice the CPU of 8.\n");
+
+    USLOSS_Console("testcase_main(): setScheduler(\"bogus\") returned %d\n", setScheduler("bogus"));
+
+    for (i = 0; i < 3; i++)
+    {
+        USLOSS_Console("testcase_main(): setScheduler(\"%s\") returned %d\n", policies[i], setScheduler(policies[i]));
+
+        spork("XXp1", XXp1, "XXp1_high", USLOSS_MIN_STACK, 1);
+        spork("XXp1", XXp1, "XXp1_low",  USLOSS_MIN_STACK, 5);
+
+        pid1 = join(&status);
+        USLOSS_Console("testcase_main(): join() returned %d, status %d\n", pid1, status);
+        pid1 = join(&status);
+        USLOSS_Console("testcase_main(): join() returned %d, status %d\n", pid1, status);
+    }
+
+    // demotion and boost
+    setScheduler("mlfq");
+    spork("Hog", Hog, NULL, USLOSS_MIN_STACK, 1);
+    join(&status);
+    USLOSS_Console("testcase_main(): mlfq levels the hog saw: %s\n", levels_seen);
+    USLOSS_Console("testcase_main(): sank to the bottom and was boosted back: %s\n",
+                   strcmp(levels_seen, "0 1 2 3 4 0") == 0 ? "yes" : "NO");
+
+    // proportional share
+    setScheduler("stride");
+    spin_until = currentTime() + 600000;
+    spork("Spinner", Spinner, (void *)0, USLOSS_MIN_STACK, 2);
+    spork("Spinner", Spinner, (void *)1, USLOSS_MIN_STACK, 3);
+    join(&status);
+    join(&status);
+    USLOSS_Console("testcase_main(): stride gave priority 2 about twice the CPU of priority 3: %s\n",
+                   spin_cpu[0] >= spin_cpu[1] * 3 / 2 && spin_cpu[0] <= spin_cpu[1] * 5 / 2 ? "yes" : "NO");
+
+    setScheduler("priority");
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("%s(): started, pid %d\n", (char *)arg, getpid());
+    quit(getpid());
+}
+
+// spin, noting each level we find ourselves on, until we have been boosted back up (or 3s have gone by)
+int Hog(void *arg)
+{
+    ProcInfo info;
+    int      start = currentTime(), last = -1, bottomed = 0;
+    char    *p     = levels_seen;
+
+    while (currentTime() - start < 3000000) {
+        burn();
+        getProcInfo(getpid(), &info);
+        if (info.level == last) continue;
+
+        p += sprintf(p, "%s%d", last == -1 ? "" : " ", info.level);
+        last = info.level;
+        if (last == 4) bottomed = 1;
+        if (bottomed && last == 0) break;
+        if (p - levels_seen > (int)sizeof(levels_seen) - 8) break;
+    }
+    quit(0);
+}
+
+int Spinner(void *arg)
+{
+    ProcInfo info;
+    int      which = (int)(long)arg;
+
+    while (currentTime() < spin_until)
+        burn();
+    getProcInfo(getpid(), &info);
+    spin_cpu[which] = info.cpu_us;
+    quit(0);
+}
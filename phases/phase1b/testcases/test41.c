@@ -0,0 +1,46 @@
+/*
+ * Check unblockProcs().
+ * Two children block themselves: XXp1_a at priority 2, then XXp1_b at
+ * priority 1.  testcase_main wakes both in a single unblockProcs() call,
+ * listing XXp1_a first.  Since the whole batch is made runnable before
+ * the dispatcher runs, XXp1_b (the higher priority) must run first.
+ * Bogus and repeated pids in the batch are skipped.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+int testcase_main()
+{
+    int pids[4], n, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: XXp1_b runs before XXp1_a after the batch wakeup, and unblockProcs() returns 2.\n");
+
+    pids[0] = spork("XXp1", XXp1, "XXp1_a", USLOSS_MIN_STACK, 2);
+    pids[1] = spork("XXp1", XXp1, "XXp1_b", USLOSS_MIN_STACK, 1);
+    pids[2] = 9999;
+    pids[3] = pids[0];
+
+    USLOSS_Console("testcase_main(): waking %d, %d, %d and %d\n", pids[0], pids[1], pids[2], pids[3]);
+    n = unblockProcs(pids, 4);
+    USLOSS_Console("testcase_main(): unblockProcs() returned %d\n", n);
+
+    join(&status);
+    join(&status);
+
+    USLOSS_Console("testcase_main(): unblockProcs() on nothing returned %d\n", unblockProcs(pids, 0));
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("%s(): blocking\n", (char *)arg);
+    blockMe();
+    USLOSS_Console("%s(): woken\n", (char *)arg);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Check wait queues.
+ * XXp1_a, XXp1_b and XXp1_c (all at a higher priority than
+ * testcase_main) sleep on the same queue, in that order.  WakeValue wakes
+ * only XXp1_a, and hands it 42; WakeAll wakes the other two, in order.
+ * XXp2 adds itself to a second queue, then blocks on something else
+ * before it gets to waitQueueBlock(), so the wakeup must wait for it.
+ * A stray unblockProc() must not wake XXp1_d out of its wait queue.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+int XXp2(void *);
+
+WaitQueue wq;
+WaitQueue wq2;
+
+int testcase_main()
+{
+    int pid, status, i;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: XXp1_a wakes with 42, then XXp1_b and XXp1_c with 7.  XXp2 and XXp1_d are each woken exactly once, by their wait queue.\n");
+
+    spork("XXp1", XXp1, "XXp1_a", USLOSS_MIN_STACK, 2);
+    spork("XXp1", XXp1, "XXp1_b", USLOSS_MIN_STACK, 2);
+    spork("XXp1", XXp1, "XXp1_c", USLOSS_MIN_STACK, 2);
+
+    USLOSS_Console("testcase_main(): %d waiting, %s is first\n", wq.count, (char *)waitQueuePeek(&wq));
+    USLOSS_Console("testcase_main(): waitQueueWakeValue() returned %d\n", waitQueueWakeValue(&wq, 42));
+    USLOSS_Console("testcase_main(): waitQueueWakeAll() returned %d\n", waitQueueWakeAll(&wq, 7));
+    USLOSS_Console("testcase_main(): waitQueueWakeOne() on an empty queue returned %d, peek returned %s\n", waitQueueWakeOne(&wq), waitQueuePeek(&wq) ? "data" : "NULL");
+
+    pid = spork("XXp2", XXp2, NULL, USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): waitQueueWakeOne() returned %d\n", waitQueueWakeOne(&wq2));
+    USLOSS_Console("testcase_main(): unblocking XXp2\n");
+    unblockProc(pid);
+
+    pid = spork("XXp1", XXp1, "XXp1_d", USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): stray unblockProc() returned %d\n", unblockProc(pid));
+    USLOSS_Console("testcase_main(): waitQueueWakeOne() returned %d\n", waitQueueWakeOne(&wq));
+
+    for (i = 0; i < 5; i++)
+        join(&status);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("%s(): sleeping\n", (char *)arg);
+    int value = waitQueueSleep(&wq, arg);
+    USLOSS_Console("%s(): woken with %d\n", (char *)arg, value);
+    return 0;
+}
+
+int XXp2(void *arg)
+{
+    USLOSS_Console("XXp2(): added to the queue, blocking elsewhere\n");
+    waitQueueAdd(&wq2, NULL);
+    blockMe();
+    USLOSS_Console("XXp2(): unblocked, calling waitQueueBlock()\n");
+    int value = waitQueueBlock();
+    USLOSS_Console("XXp2(): waitQueueBlock() returned %d without blocking\n", value);
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Check the per-process data.
+ * Reserve two pieces, then try to reserve more than is left.  Each child
+ * checks that its pieces start out zero-filled, writes its pid into them,
+ * and blocks until both children have done so before reading them back.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+int key1, key2;
+
+int testcase_main()
+{
+    int pid1, pid2, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: keys 0 and 24, then -1.  Each child reads back its own pid.\n");
+
+    key1 = procDataRegister(20);
+    key2 = procDataRegister(4);
+    USLOSS_Console("testcase_main(): procDataRegister() returned %d and %d\n", key1, key2);
+    USLOSS_Console("testcase_main(): procDataRegister(%d) returned %d\n", PROC_DATA_SIZE, procDataRegister(PROC_DATA_SIZE));
+
+    pid1 = spork("XXp1", XXp1, "XXp1_a", USLOSS_MIN_STACK, 2);
+    pid2 = spork("XXp1", XXp1, "XXp1_b", USLOSS_MIN_STACK, 2);
+    unblockProc(pid1);
+    unblockProc(pid2);
+
+    join(&status);
+    join(&status);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    int *one = procData(key1);
+    int *two = procData(key2);
+
+    USLOSS_Console("%s(): starts with %d and %d\n", (char *)arg, one[0], two[0]);
+    one[0] = getpid();
+    two[0] = -getpid();
+
+    USLOSS_Console("%s(): blocking\n", (char *)arg);
+    blockMe();
+
+    USLOSS_Console("%s(): pid %d reads back %d and %d\n", (char *)arg, getpid(), one[0], two[0]);
+    return 0;
+}
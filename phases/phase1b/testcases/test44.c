@@ -0,0 +1,59 @@
+/*
+ * Check worker pools.
+ * Start a pool of 3 workers, at a lower priority than testcase_main, and
+ * submit 6 tasks before collecting anything.  The tasks report which
+ * worker ran them: the same 3 pids should serve all 6.  Destroying the
+ * pool must fail while a task is outstanding, and succeed afterwards,
+ * leaving no children behind.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int Square(void *);
+
+int testcase_main()
+{
+    int i, ticket, result, status;
+    WorkerPool *pool;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: 6 tasks run on 3 workers, and every result is collected.  poolDestroy() fails once, then succeeds.\n");
+
+    pool = poolCreate("Worker", 3, USLOSS_MIN_STACK, 4);
+    if (!pool)
+        USLOSS_Console("testcase_main(): poolCreate() failed\n");
+    USLOSS_Console("testcase_main(): poolCreate() with no workers returned %s\n", poolCreate("Worker", 0, USLOSS_MIN_STACK, 4) ? "a pool" : "NULL");
+
+    for (i = 1; i <= 6; i++)
+    {
+        ticket = poolSubmit(pool, Square, (void *)(long)i);
+        USLOSS_Console("testcase_main(): submitted %d as ticket %d\n", i, ticket);
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        ticket = poolCollect(pool, &result);
+        USLOSS_Console("testcase_main(): collected ticket %d, result %d\n", ticket, result);
+    }
+
+    USLOSS_Console("testcase_main(): poolDestroy() with a task outstanding returned %d\n", poolDestroy(pool));
+
+    ticket = poolCollect(pool, &result);
+    USLOSS_Console("testcase_main(): collected ticket %d, result %d\n", ticket, result);
+    USLOSS_Console("testcase_main(): poolCollect() with nothing outstanding returned %d\n", poolCollect(pool, &result));
+
+    USLOSS_Console("testcase_main(): poolDestroy() returned %d\n", poolDestroy(pool));
+    USLOSS_Console("testcase_main(): join() returned %d\n", join(&status));
+
+    return 0;
+}
+
+int Square(void *arg)
+{
+    int n = (int)(long)arg;
+
+    USLOSS_Console("Square(): pid %d computing %d squared\n", getpid(), n);
+    return n * n;
+}
@@ -0,0 +1,59 @@
+/*
+ * Check priority aging.
+ * With a 10ms quantum and 20ms aging, start Low (priority 5), then Hog
+ * (priority 2), which spins calling dispatcher() for up to 2 seconds.
+ * Under strict priority Low would have to wait for Hog to finish; with
+ * aging it climbs to Hog's priority and gets a turn while Hog is busy.
+ * Low's wait shows up in the run queue wait stats for priority 5.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int Low(void *);
+int Hog(void *);
+
+int low_ran, hog_done;
+
+int testcase_main()
+{
+    int status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: Low runs while Hog is still busy, and its wait is recorded.\n");
+
+    USLOSS_Console("testcase_main(): setQuantum(0) returned %d, setAging(-1) returned %d\n", setQuantum(0), setAging(-1));
+    USLOSS_Console("testcase_main(): setQuantum(10) returned %d\n", setQuantum(10));
+    USLOSS_Console("testcase_main(): setAging(20) returned %d\n", setAging(20));
+    USLOSS_Console("testcase_main(): getMaxRunqWait(0) returned %d\n", getMaxRunqWait(0));
+
+    spork("Low", Low, NULL, USLOSS_MIN_STACK, 5);
+    spork("Hog", Hog, NULL, USLOSS_MIN_STACK, 2);
+
+    join(&status);
+    join(&status);
+
+    USLOSS_Console("testcase_main(): Low waited %s 40ms\n", getMaxRunqWait(5) >= 40000 ? "at least" : "less than");
+
+    return 0;
+}
+
+int Low(void *arg)
+{
+    USLOSS_Console("Low(): running, Hog is %s\n", hog_done ? "done" : "still busy");
+    low_ran = 1;
+    return 0;
+}
+
+int Hog(void *arg)
+{
+    int start = currentTime();
+
+    USLOSS_Console("Hog(): spinning\n");
+    while (!low_ran && currentTime() - start < 2000000)
+        dispatcher();
+    hog_done = 1;
+    USLOSS_Console("Hog(): done, Low has %s\n", low_ran ? "run" : "not run");
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * Check the preemption points.
+ * testcase_main pretends to be an interrupt handler: between
+ * interruptEnter() and interruptExit() it wakes XXp1 (higher priority).
+ * XXp1 may not run until the handler is done, and then must run at once.
+ * Outside a handler, reschedIfNeeded() does nothing unless something
+ * asked for it.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+int testcase_main()
+{
+    int pid1, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: XXp1 runs right after interruptExit(), before testcase_main prints again.\n");
+
+    pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+
+    interruptEnter();
+    USLOSS_Console("testcase_main(): in the handler, waking XXp1\n");
+    unblockProc(pid1);
+    USLOSS_Console("testcase_main(): still in the handler\n");
+    interruptExit();
+    USLOSS_Console("testcase_main(): after interruptExit()\n");
+
+    reschedIfNeeded();
+    USLOSS_Console("testcase_main(): after reschedIfNeeded()\n");
+
+    join(&status);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("XXp1(): blocking\n");
+    blockMe();
+    USLOSS_Console("XXp1(): woken\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Check critical sections and preemptDisable().
+ * criticalEnter() turns interrupts off and criticalExit() puts them back,
+ * also when nested.  Between preemptDisable() and preemptEnable(),
+ * interrupts stay on, and waking XXp1 (higher priority) does not switch
+ * to it; the outermost preemptEnable() does.  waitQueueWakeAll() on three
+ * sleepers runs them after the call, in order.  Every one of these
+ * stretches with interrupts off is timed.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+int XXp2(void *);
+
+static WaitQueue wq;
+
+static char *ints()
+{
+    return (USLOSS_PsrGet() & USLOSS_PSR_CURRENT_INT) ? "on" : "off";
+}
+
+int testcase_main()
+{
+    int pid1, status, i;
+    unsigned int outer, inner;
+    IrqsOffStats stats;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: XXp1 runs right after the outer preemptEnable(); the three XXp2 run in order after waitQueueWakeAll().\n");
+
+    resetIrqsOffStats();
+
+    outer = criticalEnter("testcase_main");
+    USLOSS_Console("testcase_main(): in a critical section, interrupts %s\n", ints());
+    inner = criticalEnter("testcase_main");
+    criticalExit(inner);
+    USLOSS_Console("testcase_main(): after the inner criticalExit(), interrupts %s\n", ints());
+    criticalExit(outer);
+    USLOSS_Console("testcase_main(): after the outer criticalExit(), interrupts %s\n", ints());
+
+    pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+
+    preemptDisable();
+    preemptDisable();
+    USLOSS_Console("testcase_main(): preemption disabled, interrupts %s, waking XXp1\n", ints());
+    unblockProc(pid1);
+    preemptEnable();
+    USLOSS_Console("testcase_main(): after the inner preemptEnable()\n");
+    preemptEnable();
+    USLOSS_Console("testcase_main(): after the outer preemptEnable()\n");
+    join(&status);
+
+    for (i = 0; i < 3; i++)
+        spork("XXp2", XXp2, (void *)(long)i, USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): waitQueueWakeAll() returned %d\n", waitQueueWakeAll(&wq, 0));
+    for (i = 0; i < 3; i++)
+        join(&status);
+
+    getIrqsOffStats(&stats);
+    USLOSS_Console("testcase_main(): timed stretches: %s, longest recorded: %s\n",
+                   stats.sections > 0 ? "yes" : "no",
+                   stats.max_where ? "yes" : "no");
+
+    resetIrqsOffStats();
+    getIrqsOffStats(&stats);
+    USLOSS_Console("testcase_main(): after resetIrqsOffStats(): %ld stretches\n", stats.sections);
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("XXp1(): blocking\n");
+    blockMe();
+    USLOSS_Console("XXp1(): woken\n");
+    return 0;
+}
+
+int XXp2(void *arg)
+{
+    waitQueueSleep(&wq, NULL);
+    USLOSS_Console("XXp2(): %d woken\n", (int)(long)arg);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Check zapTree() and zapMany().
+ * Parent (priority 2) starts two children at priority 4, and joins them.
+ * testcase_main then zaps the whole tree: all three are marked, and
+ * testcase_main blocks once, until the last of them (Parent) has quit.
+ * Then zapMany() on three priority-4 children that have not run yet:
+ * testcase_main wakes once, after all three have quit.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int Parent(void *);
+int Child(void *);
+
+int testcase_main()
+{
+    int pids[3], i, status, n;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: zapTree() returns 3 after Child1, Child2 and Parent have quit; zapMany() returns after Child3, Child4 and Child5 have quit.\n");
+
+    pids[0] = spork("Parent", Parent, NULL, USLOSS_MIN_STACK, 2);
+
+    USLOSS_Console("testcase_main(): calling zapTree(%d)\n", pids[0]);
+    n = zapTree(pids[0]);
+    USLOSS_Console("testcase_main(): zapTree() returned %d\n", n);
+    join(&status);
+    USLOSS_Console("testcase_main(): joined Parent, status %d\n", status);
+
+    pids[0] = spork("Child3", Child, "Child3", USLOSS_MIN_STACK, 4);
+    pids[1] = spork("Child4", Child, "Child4", USLOSS_MIN_STACK, 4);
+    pids[2] = spork("Child5", Child, "Child5", USLOSS_MIN_STACK, 4);
+
+    USLOSS_Console("testcase_main(): calling zapMany() on three children\n");
+    zapMany(pids, 3);
+    USLOSS_Console("testcase_main(): zapMany() returned\n");
+    for (i = 0; i < 3; i++)
+        join(&status);
+
+    return 0;
+}
+
+int Parent(void *arg)
+{
+    int status;
+
+    spork("Child1", Child, "Child1", USLOSS_MIN_STACK, 4);
+    spork("Child2", Child, "Child2", USLOSS_MIN_STACK, 4);
+
+    USLOSS_Console("Parent(): joining\n");
+    join(&status);
+    join(&status);
+    USLOSS_Console("Parent(): quitting\n");
+    return 5;
+}
+
+int Child(void *arg)
+{
+    USLOSS_Console("%s(): quitting\n", (char *)arg);
+    return 0;
+}
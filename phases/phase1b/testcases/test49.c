@@ -0,0 +1,61 @@
+/*
+ * Check the scheduling trace.
+ * With tracing on, XXp1 (priority 2) starts, blocks, and is woken by
+ * testcase_main (priority 3), which then joins it.  The events come back
+ * in order; the latencies depend on the clock, so only the counts are
+ * printed: XXp1 was switched to twice, once after a wakeup, and
+ * testcase_main twice (after XXp1 blocked, and when XXp1 quit).
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+int XXp1(void *);
+
+static char *names[] = { "?", "enqueue", "dispatch", "block", "unblock" };
+
+int testcase_main()
+{
+    TraceEvent events[32];
+    LatencyStats wakeup, runnable;
+    int pid1, status, n, i;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: the events of XXp1 starting, blocking, waking and quitting, in order; then the latency counts.\n");
+
+    if (traceStart(0) != -1)
+        USLOSS_Console("testcase_main(): traceStart(0) should have failed\n");
+    traceStart(32);
+
+    pid1 = spork("XXp1", XXp1, NULL, USLOSS_MIN_STACK, 2);
+    USLOSS_Console("testcase_main(): waking XXp1\n");
+    unblockProc(pid1);
+    join(&status);
+
+    traceStop();
+
+    n = traceRead(events, 32);
+    for (i = 0; i < n; i++)
+        USLOSS_Console("testcase_main(): event %2d: %-8s pid %d priority %d\n",
+                       i, names[events[i].type], events[i].pid, events[i].priority);
+
+    for (i = 2; i <= 3; i++) {
+        getSchedLatency(i, &wakeup, &runnable);
+        USLOSS_Console("testcase_main(): priority %d: %ld switches after a wakeup, %ld in all\n",
+                       i, wakeup.count, runnable.count);
+    }
+
+    if (getSchedLatency(7, &wakeup, &runnable) != -1)
+        USLOSS_Console("testcase_main(): getSchedLatency(7) should have failed\n");
+
+    return 0;
+}
+
+int XXp1(void *arg)
+{
+    USLOSS_Console("XXp1(): blocking\n");
+    blockMe();
+    USLOSS_Console("XXp1(): woken\n");
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Check kernel work queues.
+ * Start a work queue of 2 workers, at a lower priority than
+ * testcase_main, and queue 3 items before letting them run.  Queueing an
+ * item a second time before it has started must not run it twice.  One
+ * item queues itself again from its own func, 3 times.  workQueueFlush()
+ * returns only once all of it has run.  Destroying the work queue leaves
+ * no children behind.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+
+void Report(void *);
+void Again(void *);
+
+WorkQueue *wq;
+WorkItem   items[3];
+WorkItem   again;
+int        again_left = 3;
+
+int testcase_main()
+{
+    int i, status;
+
+    USLOSS_Console("testcase_main(): started\n");
+    USLOSS_Console("EXPECTATION: items 0, 1 and 2 run once each; the item that requeues itself runs 4 times.  All of it is done when workQueueFlush() returns.\n");
+
+    wq = workQueueCreate("kworker", 2, USLOSS_MIN_STACK, 4);
+    if (!wq)
+        USLOSS_Console("testcase_main(): workQueueCreate() failed\n");
+    USLOSS_Console("testcase_main(): workQueueCreate() with no workers returned %s\n", workQueueCreate("kworker", 0, USLOSS_MIN_STACK, 4) ? "a work queue" : "NULL");
+
+    for (i = 0; i < 3; i++)
+    {
+        workInit(&items[i], Report, (void *)(long)i);
+        USLOSS_Console("testcase_main(): queueWork(item %d) returned %d\n", i, queueWork(wq, &items[i]));
+    }
+    USLOSS_Console("testcase_main(): queueWork(item 1) again returned %d\n", queueWork(wq, &items[1]));
+
+    workInit(&again, Again, NULL);
+    USLOSS_Console("testcase_main(): queueWork(again) returned %d\n", queueWork(wq, &again));
+
+    workQueueFlush(wq);
+    USLOSS_Console("testcase_main(): workQueueFlush() returned, %d requeues left\n", again_left);
+
+    USLOSS_Console("testcase_main(): queueWork(item 1) after it ran returned %d\n", queueWork(wq, &items[1]));
+    workQueueFlush(wq);
+
+    USLOSS_Console("testcase_main(): workQueueDestroy() returned %d\n", workQueueDestroy(wq));
+    USLOSS_Console("testcase_main(): join() returned %d\n", join(&status));
+
+    return 0;
+}
+
+void Report(void *arg)
+{
+    USLOSS_Console("Report(): pid %d running item %d\n", getpid(), (int)(long)arg);
+}
+
+void Again(void *arg)
+{
+    USLOSS_Console("Again(): pid %d running, %d requeues left\n", getpid(), again_left);
+    if (again_left > 0)
+    {
+        again_left--;
+        USLOSS_Console("Again(): queueWork(again) returned %d\n", queueWork(wq, &again));
+    }
+}
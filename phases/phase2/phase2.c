@@ -4,6 +4,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "phase1.h"
 #include "phase2.h"
@@ -12,37 +13,42 @@
 
 
 // struct definitions
+// what a process blocked on a mailbox leaves for the process that completes its send or receive
 typedef struct pcb {
-    // TODO: could make one general next ptr
            void *msg_ptr; // filled by producer, read by consumer
            int msg_size;
            int msg_received;   // a flag that indicates whether the msg has been received
-
-    struct pcb *next_producer;
-    struct pcb *next_consumer;
-           int            pid;
-
 } pcb;
 
 typedef struct mslot {
     char msg[MAX_MESSAGE];
     int msg_size;
-    struct mslot *next_slot;
-    int is_alive;
+    struct mslot *next_slot;   // the next message in the mailbox, or the next free mslot
 } Mslot;
 
 typedef struct mbox {
     Mslot *first_mslot;
+    Mslot *last_mslot;
     int numSlots; // number of available slots in this mailbox
 
     int is_alive;
     int maxMsgSize; // the maximum size a message can be in this mailbox's slots
 
-    // queues
-    pcb *producers;
-    pcb *consumers;
+    // queues of blocked processes, each waiting with its pcb as the wait data
+    // they are woken with -1 if the mailbox is released
+    WaitQueue producers;
+    WaitQueue consumers;
 } Mbox;
 
+// a disk or terminal unit whose interrupts go to a work queue, see deviceWork()
+typedef struct dev_work {
+    WorkItem   item;
+    WorkQueue *wq;       // NULL: interrupts go to the unit's mailbox
+    void     (*func)(int unit, int status);
+    int        unit;
+    int        status;   // from the latest interrupt
+} DevWork;
+
 
 
 
@@ -54,27 +60,39 @@ unsigned int disable_interrupts            (                               );
 void         restore_interrupts            (      unsigned int old_psr     );
 unsigned int check_and_disable             (const char        *func        );
 void         phase2_start_service_processes();
+static Mslot *mslot_alloc                  (                               );
+static void   mslot_free                   (      Mslot       *mslot       );
 int          sendHelp(int mbox_id, void *msg_ptr, int msg_size, int block);
 int          recvHelp(int mbox_id, void *msg_ptr, int msg_max_size, int block);
 
+static void dev_work_run(void *arg);
+static void dev_interrupt(DevWork *work, int mbox_id, int status);
 static void clock_handler(int dev, void *arg);
 static void term_handler(int dev, void *arg);
 static void disk_handler(int dev, void *arg);
 static void syscallHandler(int dev, void *arg);
 static void nullsys(USLOSS_Sysargs *arg);
+static void kernDumpProcesses(USLOSS_Sysargs *arg);
 
 /*************** GLOBAL VARIABLES ***************/
 static Mbox mboxes[MAXMBOX];
 static Mslot mslots[MAXSLOTS];
-static pcb shadow_proc_table[MAXPROC];
+static Mslot *free_mslots; // unused mslots, linked through next_slot
+static int   pcb_key; // our pcb's place in each process's phase1 data
 void (*systemCallVec[MAXSYSCALLS])(USLOSS_Sysargs *args);
 
 // mbox ids for devices
 int clock_mbox_id;
 int disk_mbox_ids[2];
-int term_mbox_ids[3];
+int term_mbox_ids[4];
+
+// work queue routing for the same units
+static DevWork disk_work[2];
+static DevWork term_work[4];
 
 int time_ofLastSend;
+int time_ofLastTick;
+int tick_ms = 100;  // how often the clock handler calls the dispatcher; PHASE2_TICK_MS sets it at boot
 
 /*************** SERVICE FUNCTIONS ***************/
 
@@ -90,14 +108,7 @@ void check_kernel_mode(const char *func) {
 
 // updates psr to turn interrupts on
 void enable_interrupts() {
-    // enable interrupts
-    int psr_status = USLOSS_PsrSet(USLOSS_PsrGet() | USLOSS_PSR_CURRENT_INT);
-
-    // halt simulation if psr_status is nonzero
-    if (psr_status)  {
-        USLOSS_Console("ERROR: Failed to disable interrupts!\n");
-        USLOSS_Halt(1);
-    }
+    criticalExit(USLOSS_PsrGet() | USLOSS_PSR_CURRENT_INT);
 }
 
 // updates psr to turn interrupts off
@@ -120,20 +131,15 @@ unsigned int disable_interrupts() {
 }
 
 // updates psr status to reinstate old interrupt status
+// goes through phase1, which times how long interrupts were off
 void restore_interrupts(unsigned int old_psr) {
-    int psr_status = USLOSS_PsrSet(old_psr);
-
-    // halt simulation if psr_status is nonzero
-    if (psr_status)  {
-        USLOSS_Console("ERROR: Failed to disable interrupts!\n");
-        USLOSS_Halt(1);
-    }
+    criticalExit(old_psr);
 }
 
 // check for kernel mode -- save and disable interrupts
+// goes through phase1, which times how long interrupts stay off from here
 unsigned int check_and_disable(const char *func) {
-    check_kernel_mode(func);
-    return disable_interrupts();
+    return criticalEnter(func);
 }
 
 
@@ -144,19 +150,51 @@ void phase2_init() {
     // initialize mboxes to 0s
     for (int i = 0; i < MAXMBOX; i++) memset(&mboxes[i], 0, sizeof(Mbox));
 
-    // initialize mslots to 0s
+    // initialize mslots to 0s, and put them all on the free list
     for (int i = 0; i < MAXSLOTS; i++) memset(&mslots[i], 0, sizeof(Mslot));
+    free_mslots = NULL;
+    for (int i = MAXSLOTS - 1; i >= 0; i--) mslot_free(&mslots[i]);
 
-    // initialize shadow_proc_table to 0s
-    for (int i = 0; i < MAXPROC; i++) memset(&shadow_proc_table[i], 0, sizeof(pcb));
+    // reserve room for a pcb in every process
+    pcb_key = procDataRegister(sizeof(pcb));
+    if (pcb_key < 0) {
+        USLOSS_Console("ERROR: No room for the phase2 pcb in the phase1 process data!\n");
+        USLOSS_Halt(1);
+    }
 
     // allocate mailboxes for interrupt handlers
     clock_mbox_id = MboxCreate(1, sizeof(int));
     for (int i = 0; i < 2; i++) disk_mbox_ids[i] = MboxCreate(1, sizeof(int));
     for (int i = 0; i < 4; i++) term_mbox_ids[i] = MboxCreate(1, sizeof(int));
 
+    // no unit sends its interrupts to a work queue yet
+    for (int i = 0; i < 2; i++) {
+        memset(&disk_work[i], 0, sizeof(DevWork));
+        workInit(&disk_work[i].item, dev_work_run, &disk_work[i]);
+        disk_work[i].unit = i;
+    }
+    for (int i = 0; i < 4; i++) {
+        memset(&term_work[i], 0, sizeof(DevWork));
+        workInit(&term_work[i].item, dev_work_run, &term_work[i]);
+        term_work[i].unit = i;
+    }
+
     // initialize clock time
     time_ofLastSend = 0;
+    time_ofLastTick = 0;
+
+    // the preemption tick, from the environment if it's there
+    // parsed strictly, like phase1's PHASE1_QUANTUM_MS: trailing junk or an out of range value halts
+    char *tick = getenv("PHASE2_TICK_MS");
+    if (tick) {
+        char *end;
+        long  ms = strtol(tick, &end, 10);
+        if (!*tick || *end || ms < 1 || ms != (int)ms) {
+            USLOSS_Console("ERROR: Bad value '%s' for PHASE2_TICK_MS.\n", tick);
+            USLOSS_Halt(1);
+        }
+        tick_ms = ms;
+    }
 
     // fill the interrupt vector with the appropriate functions
     USLOSS_IntVec[USLOSS_CLOCK_INT] = clock_handler;
@@ -166,6 +204,7 @@ void phase2_init() {
 
     // fill the system call vector
     for (int i = 0; i < MAXSYSCALLS; i++) systemCallVec[i] = nullsys;
+    systemCallVec[SYS_DUMPPROCESSES] = kernDumpProcesses;
 
     restore_interrupts(old_psr);
 }
@@ -178,6 +217,23 @@ void phase2_start_service_processes() {
 
 /*************** MBOX FUNCTIONS ***************/
 
+// takes an mslot off the free list
+// returns NULL if the system has run out of them
+static Mslot *mslot_alloc() {
+    Mslot *mslot = free_mslots;
+    if (mslot) {
+        free_mslots = mslot->next_slot;
+        mslot->next_slot = NULL;
+    }
+    return mslot;
+}
+
+// puts an mslot back on the free list
+static void mslot_free(Mslot *mslot) {
+    mslot->next_slot = free_mslots;
+    free_mslots = mslot;
+}
+
 // returns id of mailbox, or -1 if no more mailboxes, or -1 if invalid args
 int MboxCreate(int slots, int slot_size) {
     // disable interrupts, save old interrupt state, check for kernel mode
@@ -225,35 +281,28 @@ int MboxRelease(int mbox_id) {
     mbox->is_alive = 0;
 
     // free slots consumed by the mailbox
-    Mslot *prev = NULL;
     Mslot *cur = mbox->first_mslot;
     while (cur) {
-        if (prev) memset(prev, 0, sizeof(Mslot));
-
-        prev = cur;
-        cur = cur->next_slot;
+        Mslot *next = cur->next_slot;
+        mslot_free(cur);
+        cur = next;
     }
 
-    // unblock producers
-    pcb *producer = mbox->producers;
-    while (producer) {
-        unblockProc(producer->pid);
-        producer = producer->next_producer;
-    }
-
-    // unblock consumers
-    pcb *consumer = mbox->consumers;
-    while (consumer) {
-        unblockProc(consumer->pid);
-        consumer = consumer->next_consumer;
-    }
+    // take the blocked processes, producers then consumers, so they can be woken after the
+    // mailbox is reset and interrupts are back on
+    WaitQueue blocked;
+    waitQueueInit(&blocked);
+    waitQueueSplice(&blocked, &mbox->producers);
+    waitQueueSplice(&blocked, &mbox->consumers);
 
     // set to zeros
     memset(mbox, 0, sizeof(Mbox));
 
-
     restore_interrupts(old_psr);
 
+    // unblock them all, so the dispatcher runs once for all of them
+    waitQueueWakeAll(&blocked, -1);
+
     return 0;
 }
 
@@ -278,10 +327,9 @@ int MboxCondRecv(int mbox_id, void *msg_ptr, int max_msg_size) {
     return recvHelp(mbox_id, msg_ptr, max_msg_size, 0);
 }
 
-// get a ptr to current process in proc table
+// get a ptr to the current process's pcb
 pcb *get_cur_proc() {
-    int pid = getpid();
-    return &shadow_proc_table[pid % MAXPROC];
+    return procData(pcb_key);
 }
 
 int sendHelp(int mbox_id, void *msg_ptr, int msg_size, int block) {
@@ -304,9 +352,9 @@ int sendHelp(int mbox_id, void *msg_ptr, int msg_size, int block) {
         return -1;
     }
 
-    if (mbox->consumers) {
+    if (mbox->consumers.count) {
         // IF CONSUMER WAITING, DELIVER MSG DIRECTLY
-        pcb *consumer_proc = mbox->consumers;
+        pcb *consumer_proc = waitQueuePeek(&mbox->consumers);
 
         // write the message to the consumer -- if the ptr is not NULL
         if (msg_ptr) {
@@ -315,39 +363,26 @@ int sendHelp(int mbox_id, void *msg_ptr, int msg_size, int block) {
         }
 
         // dequeue and unblock the consumer
-        mbox->consumers = consumer_proc->next_consumer;
-        unblockProc(consumer_proc->pid);
+        waitQueueWakeOne(&mbox->consumers);
 
     } else if (mbox->numSlots) {
         // IF AVAILABLE MSLOTS QUEUE MESSAGE
 
-        // find the next empty mslot
-        int mslot_id = -2;
-        for (int i = 0; i < MAXSLOTS; i++) {
-            if (!mslots[i].is_alive) {
-                mslot_id = i;
-                break;
-            }
-        }
+        // take the next empty mslot
+        Mslot *mslot = mslot_alloc();
 
         // check if the system has run out of global mslots
         // if so, msg could not be queued, throw error
-        if (mslot_id == -2) return -2;
+        if (!mslot) return -2;
 
         // fill newly allocated mslot
-        Mslot *mslot = &mslots[mslot_id];
-        mslot->is_alive = 1;
         memcpy(mslot->msg, msg_ptr, msg_size);
         mslot->msg_size = msg_size;
 
-        // add mslot to mbox mslot queue
-        Mslot *cur = mbox->first_mslot;
-        if (!cur) {
-            mbox->first_mslot = mslot;
-        } else {
-            while (cur->next_slot) cur = cur->next_slot;
-            cur->next_slot = mslot;
-        }
+        // add mslot to the back of the mbox mslot queue
+        if (mbox->last_mslot) mbox->last_mslot->next_slot = mslot;
+        else                  mbox->first_mslot          = mslot;
+        mbox->last_mslot = mslot;
 
         // decrement the number of available mslots for the mbox
         mbox->numSlots--;
@@ -360,21 +395,9 @@ int sendHelp(int mbox_id, void *msg_ptr, int msg_size, int block) {
         // copy message to process
         self->msg_ptr = msg_ptr;
         self->msg_size = msg_size;
-        self->pid = getpid(); // set pid
-
-        // add self to producer queue and block
-        pcb *cur_proc = mbox->producers;
-        if (!cur_proc) {
-            mbox->producers = self;
-        } else {
-            while (cur_proc->next_producer) cur_proc = cur_proc->next_producer;
-            cur_proc->next_producer = self;
-        }
-
-        blockMe();
 
-        // check if the mailbox was released
-        if (!mbox->is_alive) return -1;
+        // add self to producer queue and block, then check if the mailbox was released
+        if (waitQueueSleep(&mbox->producers, self) < 0) return -1;
     } else {
         return -2;
     }
@@ -415,17 +438,33 @@ int recvHelp(int mbox_id, void *msg_ptr, int max_msg_size, int block) {
 
         // free the mslot
         mbox->first_mslot = mslot->next_slot;
-        memset(mslot, 0, sizeof(Mslot));
+        if (!mbox->first_mslot) mbox->last_mslot = NULL;
+        mslot_free(mslot);
 
         // increment the mbox's number of available mslots
         mbox->numSlots++;
 
-        // don't unblock a producer here -- they will get delivered to directly
-    } else if (mbox->producers) {
+        // the freed mslot goes to the first blocked producer, if any: queue its message and unblock it
+        // (otherwise a full mailbox used as a lock, like phase4's 1-slot write mailbox, never lets it in)
+        if (mbox->producers.count) {
+            pcb   *producer = waitQueuePeek(&mbox->producers);
+            Mslot *next     = mslot_alloc();
+
+            memcpy(next->msg, producer->msg_ptr, producer->msg_size);
+            next->msg_size = producer->msg_size;
+            if (mbox->last_mslot) mbox->last_mslot->next_slot = next;
+            else                  mbox->first_mslot          = next;
+            mbox->last_mslot = next;
+            mbox->numSlots--;
+
+            producer->msg_received = 1;
+            waitQueueWakeOne(&mbox->producers);
+        }
+    } else if (mbox->producers.count) {
         // CONSUME DIRECTLY FROM PRODUCER
 
         // consume message
-        pcb *producer = mbox->producers;
+        pcb *producer = waitQueuePeek(&mbox->producers);
         producer->msg_received = 1;
         
         // set msg size
@@ -439,35 +478,26 @@ int recvHelp(int mbox_id, void *msg_ptr, int max_msg_size, int block) {
         if (msg_ptr) memcpy(msg_ptr, producer->msg_ptr, msg_size);
 
         // remove producer from queue and unblock
-        mbox->producers = producer->next_producer;
-        unblockProc(producer->pid);
+        waitQueueWakeOne(&mbox->producers);
     }  else if (block) {
         // BLOCK -- WAITING ON DIRECT DELIVERY
 
         pcb *self = get_cur_proc();
-        self->pid = getpid(); // set pid
 
         // init msg ptr
         char buf[max_msg_size];
         self->msg_ptr = buf;
 
         // add self to consumer queue and block
-        pcb *cur_proc = mbox->consumers;
-        if (!cur_proc) {
-            mbox->consumers = self;
-        } else {
-            while (cur_proc->next_consumer) cur_proc = cur_proc->next_consumer;
-            cur_proc->next_consumer = get_cur_proc();
-        }
-        blockMe();
+        int released = waitQueueSleep(&mbox->consumers, self) < 0;
 
         // AFTER BLOCK -- (a) MBOX RELEASED OR (b) MSG HAS BEEN DIRECTLY DELIVERED
 
         // check if the mbox was released
-        if (!mbox->is_alive) return -1;
+        if (released) return -1;
 
         // consume msg
-        pcb *consumer_proc = get_cur_proc();
+        pcb *consumer_proc = self;
         msg_size = consumer_proc->msg_size;
 
         // check if the message is too large for the buffer
@@ -508,9 +538,60 @@ void waitDevice(int type, int unit, int *status) {
     restore_interrupts(old_psr);
 }
 
+int deviceWork(int type, int unit, struct WorkQueue *wq, void (*func)(int unit, int status)) {
+    // disable interrupts, save old interrupt state, check for kernel mode
+    unsigned int old_psr = check_and_disable(__func__);
+
+    DevWork *work;
+    if (type == USLOSS_DISK_INT && (unit == 0 || unit == 1)) {
+        work = &disk_work[unit];
+    } else if (type == USLOSS_TERM_INT && (unit == 0 || unit == 1 || unit == 2 || unit == 3)) {
+        work = &term_work[unit];
+    } else {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    if (wq && !func) {
+        restore_interrupts(old_psr);
+        return -1;
+    }
+
+    // an item that is already queued runs the new func, or nothing
+    work->wq   = wq;
+    work->func = wq ? func : NULL;
+
+    restore_interrupts(old_psr);
+    return 0;
+}
+
+// runs on a work queue worker, with interrupts enabled
+static void dev_work_run(void *arg) {
+    DevWork *work = arg;
+
+    unsigned int old_psr = check_and_disable(__func__);
+    void (*func)(int, int) = work->func;
+    int status = work->status;
+    restore_interrupts(old_psr);
+
+    if (func) func(work->unit, status);
+}
+
+// called by a device handler with the unit's status
+// sends it to the unit's mailbox, or queues the unit's work item
+static void dev_interrupt(DevWork *work, int mbox_id, int status) {
+    if (work->wq) {
+        work->status = status;
+        queueWork(work->wq, &work->item);
+    } else {
+        MboxCondSend(mbox_id, (void *) &status, sizeof(int));
+    }
+}
+
 static void clock_handler(int dev, void *arg) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
+    interruptEnter();
     
     // get the time since last msg send in ms.
     int new_clock_time = currentTime();
@@ -527,11 +608,17 @@ static void clock_handler(int dev, void *arg) {
 
         // send status as payload for msg
         MboxCondSend(clock_mbox_id, (void *) &status, sizeof(int));
+    }
 
-        // call the dispatcher
-        dispatcher();
+    // let the dispatcher preempt the current process, every tick_ms
+    if ((new_clock_time - time_ofLastTick)/1000 >= tick_ms) {
+        time_ofLastTick = new_clock_time;
+        requestResched();
     }
 
+    // any wakeups above get their dispatcher call here, once the handler is done
+    interruptExit();
+
 
     restore_interrupts(old_psr);
     
@@ -540,6 +627,7 @@ static void clock_handler(int dev, void *arg) {
 static void term_handler(int dev, void *arg) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
+    interruptEnter();
 
     // retreieve terminal number from arg
     int term_no = (int)(long) arg;
@@ -549,15 +637,18 @@ static void term_handler(int dev, void *arg) {
     int input_status = USLOSS_DeviceInput(dev, term_no, &status);
 
     // send status as payload for msg
+    // or hand it to the unit's work queue, if it has one
     int mbox_id = term_mbox_ids[term_no];
-    MboxCondSend(mbox_id, (void *) &status, sizeof(int));
+    dev_interrupt(&term_work[term_no], mbox_id, status);
 
+    interruptExit();
     restore_interrupts(old_psr);
 }
 
 static void disk_handler(int dev, void *arg) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
+    interruptEnter();
 
     // retrieve disk number from arg
     int disk_no = (int)(long) arg;
@@ -567,9 +658,11 @@ static void disk_handler(int dev, void *arg) {
     int input_status = USLOSS_DeviceInput(dev, disk_no, &status);
 
     // send status as payload for msg
+    // or hand it to the unit's work queue, if it has one
     int mbox_id = disk_mbox_ids[disk_no];
-    MboxCondSend(mbox_id, (void *) &status, sizeof(int));
+    dev_interrupt(&disk_work[disk_no], mbox_id, status);
 
+    interruptExit();
     restore_interrupts(old_psr);
 }
 
@@ -581,7 +674,8 @@ static void syscallHandler(int dev, void *arg) {
     int syscall_num = arg_struct->number;
 
     if (syscall_num >= 0 && syscall_num < MAXSYSCALLS) {
-        // if the syscall num is valid, call the function in the vector
+        // if the syscall num is valid, count it against the caller and call the function in the vector
+        accountSyscall();
         systemCallVec[syscall_num](arg_struct);
     } else {
         // otherwise, print error and halt simulation
@@ -589,10 +683,17 @@ static void syscallHandler(int dev, void *arg) {
         USLOSS_Halt(1);
     }
 
+    // preempt now if the syscall woke something more important than us
+    reschedIfNeeded();
 
     restore_interrupts(old_psr);
 }
 
+// prints the process table for user mode code
+static void kernDumpProcesses(USLOSS_Sysargs *arg) {
+    dumpProcesses();
+}
+
 static void nullsys(USLOSS_Sysargs *arg) {
     // disable interrupts, save old interrupt state, check for kernel mode
     unsigned int old_psr = check_and_disable(__func__);
@@ -41,6 +41,16 @@ extern int MboxCondRecv(int mbox_id, void *msg_ptr, int msg_max_size);
 extern void     waitDevice(int type, int unit, int *status);
 extern void wakeupByDevice(int type, int unit, int status);
 
+// sends the disk or terminal unit's interrupts to a phase 1 work queue instead
+// of its mailbox: each one runs func(unit, status) on one of wq's workers.  an
+// interrupt that comes before func has started replaces the status it gets.
+// wq == NULL goes back to the mailbox, for waitDevice(); a status already
+// queued for the work queue is dropped.
+// returns 0 if successful, -1 if invalid args
+struct WorkQueue;
+extern int deviceWork(int type, int unit, struct WorkQueue *wq,
+                      void (*func)(int unit, int status));
+
 // 
 extern void (*systemCallVec[])(USLOSS_Sysargs *args);
 
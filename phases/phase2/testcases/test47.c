@@ -0,0 +1,62 @@
+/* A test of the per-process syscall count.  start2 puts itself into user
+ * mode and makes three calls to syscall 10, then one to syscall 11, whose
+ * handler reports start2's info from getProcInfo() and halts.  All four
+ * syscalls should have been counted.
+ */
+
+#include <stdio.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+
+extern void USLOSS_Syscall(void *arg);
+
+static void sys_nop(USLOSS_Sysargs *args)
+{
+}
+
+static void sys_report(USLOSS_Sysargs *args)
+{
+    ProcInfo info;
+
+    getProcInfo(getpid(), &info);
+    USLOSS_Console("sys_report(): %s has made %ld syscalls\n", info.name, info.syscalls);
+    USLOSS_Halt(0);
+}
+
+void enableUserMode(){
+    int result;
+
+    result = USLOSS_PsrSet( USLOSS_PsrGet() & (~ USLOSS_PSR_CURRENT_MODE) );
+    if ( result != USLOSS_DEV_OK ) {
+        USLOSS_Console("enableUserMode(): USLOSS_PsrSet returned %d ", result);
+        USLOSS_Console("Halting...\n");
+        USLOSS_Halt(1);
+    }
+}
+
+
+
+int start2(void *arg)
+{
+    USLOSS_Sysargs args;
+    int i;
+
+    systemCallVec[10] = sys_nop;
+    systemCallVec[11] = sys_report;
+
+    USLOSS_Console("start2(): putting itself into user mode\n");
+    enableUserMode();
+
+    USLOSS_Console("start2(): calling syscall 10 three times, then syscall 11\n");
+
+    for (i = 0; i < 3; i++) {
+        args.number = 10;
+        USLOSS_Syscall((void *)&args);
+    }
+    args.number = 11;
+    USLOSS_Syscall((void *)&args);
+
+    USLOSS_Console("start2(): ERROR ERROR ERROR should not see this message!\n");
+    return 0; /* so gcc will not complain about its absence... */
+}
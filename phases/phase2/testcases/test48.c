@@ -0,0 +1,67 @@
+/* A test of deviceWork() for a terminal.  Receive interrupts from
+ * terminal 1 go to a work queue with one worker, at a higher priority
+ * than start2, which prints each character.  After the first line, the
+ * terminal goes back to its mailbox, and waitDevice() gets the next
+ * character.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <phase2.h>
+
+void TermDone(int unit, int status);
+
+int line_mbox;
+
+
+
+int start2(void *arg)
+{
+    long control = 0;
+    int  result, status;
+    WorkQueue *wq;
+
+    USLOSS_Console("start2(): started\n");
+
+    line_mbox = MboxCreate(1, 0);
+
+    wq = workQueueCreate("termwork", 1, USLOSS_MIN_STACK, 1);
+    USLOSS_Console("start2(): deviceWork() for the clock returned %d\n", deviceWork(USLOSS_CLOCK_DEV, 0, wq, TermDone));
+    USLOSS_Console("start2(): deviceWork() for terminal 1 returned %d\n", deviceWork(USLOSS_TERM_DEV, 1, wq, TermDone));
+
+    /* see macro definition in usloss.h */
+    control = USLOSS_TERM_CTRL_RECV_INT(control);
+
+    result = USLOSS_DeviceOutput(USLOSS_TERM_DEV, 1, (void *)control);
+    if ( result != USLOSS_DEV_OK ) {
+        USLOSS_Console("start2(): USLOSS_DeviceOutput returned %d ", result);
+        USLOSS_Console("Halting...\n");
+        USLOSS_Halt(1);
+    }
+
+    MboxRecv(line_mbox, NULL, 0);
+    USLOSS_Console("start2(): the work queue got a whole line\n");
+
+    USLOSS_Console("start2(): deviceWork(NULL) returned %d\n", deviceWork(USLOSS_TERM_DEV, 1, NULL, NULL));
+    waitDevice(USLOSS_TERM_DEV, 1, &status);
+    USLOSS_Console("start2(): waitDevice() got character %c\n", USLOSS_TERM_STAT_CHAR(status));
+
+    USLOSS_Console("start2(): workQueueDestroy() returned %d\n", workQueueDestroy(wq));
+
+    quit(0);
+}
+
+void TermDone(int unit, int status)
+{
+    char c = USLOSS_TERM_STAT_CHAR(status);
+
+    if (c == '\n')
+    {
+        USLOSS_Console("TermDone(): terminal %d, end of line\n", unit);
+        MboxSend(line_mbox, NULL, 0);
+    }
+    else
+        USLOSS_Console("TermDone(): terminal %d, character received = %c\n", unit, c);
+}
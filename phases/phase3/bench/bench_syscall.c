@@ -0,0 +1,39 @@
+/*
+ * Null system call microbenchmark.
+ *
+ * start3 runs in user mode and calls GetPID() over and over, so each call
+ * is one full round trip: USLOSS_Syscall(), the trap into the kernel, the
+ * phase 2 system call vector, and the return to user mode.
+ */
+
+#include <usloss.h>
+#include <usyscall.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3_usermode.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CALLS 1000000
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int start3(void *arg)
+{
+    int pid;
+
+    long long start = now_ns();
+    for (int i = 0; i < CALLS; i++)
+        GetPID(&pid);
+    long long elapsed = now_ns() - start;
+
+    USLOSS_Console("bench_syscall: GetPID  calls=%d  ns/call=%lld  calls/s=%lld\n",
+                   CALLS, elapsed / CALLS, CALLS * 1000000000LL / elapsed);
+
+    Terminate(0);
+}
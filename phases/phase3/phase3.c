@@ -7,8 +7,8 @@
 
 // function stubs
 void require_kernel_mode(const char *func);
-void gain_mutex(const char *func);
-void release_mutex(const char *func);
+static void gain_mutex(const char *func);
+static void release_mutex(const char *func);
 void phase3_init();
 void phase3_start_service_processes();
 void set_user_mode();
@@ -24,6 +24,7 @@ void SemP_K        (USLOSS_Sysargs *arg      );
 void SemV_K        (USLOSS_Sysargs *arg      );
 void GetTimeofDay_K(USLOSS_Sysargs *arg      );
 void GetPID_K      (USLOSS_Sysargs *arg      );
+void GetProcInfo_K (USLOSS_Sysargs *arg      );
 int  kernSemCreate (int             value     ,
                     int            *semaphore);
 int  kernSemP      (int             semaphore);
@@ -33,22 +34,16 @@ int  kernSemV      (int             semaphore);
 extern void Terminate(int status);
 
 // struct definitions
-typedef struct pcb {
-    int pid;
-    struct pcb *next;
-} pcb;
-
 typedef struct semaphore {
     /*int sem_id;*/
     int is_alive;
     int value;
-    pcb *blocked_queue;
+    WaitQueue blocked_queue;
 } Semaphore;
 
 // globals
-int mutex;
+static int mutex;
 Semaphore sems[MAXSEMS];
-static pcb shadow_proc_table[MAXPROC];
 
 // verifies that the program is currently running in kernel mode and halts if not 
 void require_kernel_mode(const char *func) {
@@ -70,13 +65,13 @@ void set_user_mode() {
     // TODO: perform error checking for status?
 }
 
-void gain_mutex(const char *func) {
+static void gain_mutex(const char *func) {
     /*USLOSS_Console("%s IS TRYING TO GAIN THE MUTEX!\n", func);*/
     MboxSend(mutex, NULL, 0);
     /*USLOSS_Console("%s HAS GAINED THE MUTEX!\n", func);*/
 }
 
-void release_mutex(const char *func) {
+static void release_mutex(const char *func) {
     /*USLOSS_Console("%s IS TRYING TO RELEASE THE MUTEX!\n", func);*/
     MboxRecv(mutex, NULL, 0);
     /*USLOSS_Console("%s HAS RELEASED THE MUTEX!\n", func);*/
@@ -95,9 +90,6 @@ void phase3_init() {
     // initialize the semaphores to 0s
     for (int i = 0; i < MAXSEMS; i++) memset(&sems[i], 0, sizeof(Semaphore));
 
-    // initialize the shadow proc table to 0s
-    for (int i = 0; i < MAXPROC; i++) memset(&shadow_proc_table[i], 0, sizeof(pcb));
-
     // fill system call vector
     systemCallVec[SYS_SPAWN]        =        Spawn_K;
     systemCallVec[SYS_WAIT]         =         Wait_K;
@@ -107,6 +99,7 @@ void phase3_init() {
     systemCallVec[SYS_SEMV]         =         SemV_K;
     systemCallVec[SYS_GETTIMEOFDAY] = GetTimeofDay_K;
     systemCallVec[SYS_GETPID]       =       GetPID_K;
+    systemCallVec[SYS_GETPROCINFO]  =  GetProcInfo_K;
 
     // release mutual exclusion
     release_mutex(__func__);
@@ -138,7 +131,9 @@ void Spawn_K(USLOSS_Sysargs *arg) {
     int childPid = spork(name, trampoline, (void *)(long)mboxId, stack_size, priority);
     
     // repack the pid -- must cast to void *
+    // arg4 is the result: -1 if spork() refused the request, 0 otherwise
     arg->arg1 = (void *)(long)childPid;
+    arg->arg4 = (void *)(long)(childPid < 0 ? -1 : 0);
 }
 
 int trampoline(void *arg) {
@@ -346,22 +341,12 @@ int kernSemP(int semaphore) {
 
     if (sem->value == 0) {
         // add self to sem's blocked queue and block
-        int pid = getpid();
-        pcb *to_queue = &shadow_proc_table[pid % MAXPROC];
-        to_queue->pid = pid;
-
-        pcb *cur = sem->blocked_queue;
-        if (!cur) {
-            sem->blocked_queue = to_queue;
-        } else {
-            while (cur->next) cur = cur->next;
-            cur->next = to_queue;
-        }
+        waitQueueAdd(&sem->blocked_queue, NULL);
 
         // release the mutex before blocking
         release_mutex(__func__);
 
-        blockMe();
+        waitQueueBlock();
 
         // gain back mutex
         gain_mutex(__func__);
@@ -428,11 +413,7 @@ int kernSemV(int semaphore) {
     sem->value++;
 
     // unblock a proc that's blocked on the semaphore if one exists
-    if (sem->blocked_queue) {
-        int pid_toUnblock = sem->blocked_queue->pid;
-        sem->blocked_queue = sem->blocked_queue->next;
-        unblockProc(pid_toUnblock);
-    }
+    waitQueueWakeOne(&sem->blocked_queue);
 
     return 0;
 }
@@ -464,3 +445,21 @@ void GetPID_K(USLOSS_Sysargs *arg) {
     // release mutex
     release_mutex(__func__);
 }
+
+void GetProcInfo_K(USLOSS_Sysargs *arg) {
+    // check for kernel mode
+    require_kernel_mode(__func__);
+
+    // unpack arguments
+    int       pid  = (int)(long)arg->arg1;
+    ProcInfo *info = (ProcInfo *)arg->arg2;
+
+    // check for invalid inputs
+    if (!info) {
+        arg->arg4 = (void *)(long)-1;
+        return;
+    }
+
+    // store return value; phase1 copies the accounting out atomically, so no mutex
+    arg->arg4 = (void *)(long)getProcInfo(pid, info);
+}
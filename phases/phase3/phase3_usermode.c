@@ -4,6 +4,7 @@
 
 #include <usloss.h>
 #include <usyscall.h>
+#include <phase1.h>
 
 #include "phase3_usermode.h"
 
@@ -187,3 +188,20 @@ void DumpProcesses(void)
     return;
 }
 
+
+
+int GetProcInfo(int pid, ProcInfo *info)
+{
+    require_user_mode(__func__);
+
+    USLOSS_Sysargs args;
+    memset(&args, 0, sizeof(args));
+
+    args.number = SYS_GETPROCINFO;
+    args.arg1 = (void*)(long)pid;
+    args.arg2 = info;
+    USLOSS_Syscall(&args);
+
+    return (int)(long)args.arg4;
+}
+
@@ -5,6 +5,8 @@
 #ifndef _PHASE3_USERMODE_H
 #define _PHASE3_USERMODE_H
 
+#include <phase1.h>       // ProcInfo
+
 // Phase 3 -- User Function Prototypes
 extern int  Spawn(char *name, int (*func)(void*), void *arg, int stack_size,
                   int priority, int *pid);
@@ -19,5 +21,6 @@ extern int  SemV(int semaphore);
    // NOTE: No SemFree() call, it was removed
 
 extern void DumpProcesses(void);
+extern int  GetProcInfo(int pid, ProcInfo *info);
 
 #endif
@@ -0,0 +1,57 @@
+/*
+ * GetProcInfo test.  Child1 (priority 4) checks its own info and
+ * terminates.  start3, which blocked in Wait meanwhile, then checks its
+ * own info (including the count of its syscalls, four so far) and
+ * Child1's (which is gone after the Wait), and passes an invalid pointer.
+ */
+
+#include <usloss.h>
+#include <usyscall.h>
+#include <phase1.h>
+#include <phase2.h>
+#include <phase3_usermode.h>
+#include <stdio.h>
+
+static char *states[] = { "running", "runnable", "blocked", "quit" };
+
+int Child1(void *);
+
+int start3(void *arg)
+{
+    ProcInfo info;
+    int pid, mypid, status, rc;
+
+    USLOSS_Console("start3(): started.  Calling Spawn for Child1\n");
+
+    Spawn("Child1", Child1, NULL, USLOSS_MIN_STACK, 4, &pid);
+    Wait(&pid, &status);
+    USLOSS_Console("start3(): Child1 (pid %d) terminated, status %d\n", pid, status);
+
+    GetPID(&mypid);
+    rc = GetProcInfo(mypid, &info);
+    USLOSS_Console("start3(): GetProcInfo(self) returned %d: name %s, priority %d, %s, %s, %s\n",
+                   rc, info.name, info.priority, states[info.state],
+                   info.vol_switches > 0 ? "has blocked" : "never blocked",
+                   info.syscalls >= 4 ? "syscalls counted" : "syscalls NOT counted");
+
+    rc = GetProcInfo(pid, &info);
+    USLOSS_Console("start3(): GetProcInfo(Child1) returned %d\n", rc);
+
+    rc = GetProcInfo(mypid, NULL);
+    USLOSS_Console("start3(): GetProcInfo(self, NULL) returned %d\n", rc);
+
+    Terminate(0);
+}
+
+int Child1(void *arg)
+{
+    ProcInfo info;
+    int pid;
+
+    GetPID(&pid);
+    GetProcInfo(pid, &info);
+    USLOSS_Console("Child1(): name %s, priority %d, %s\n",
+                   info.name, info.priority, states[info.state]);
+
+    Terminate(3);
+}
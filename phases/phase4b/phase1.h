@@ -8,7 +8,8 @@
 #include <usloss.h>
 
 /*
- * Maximum number of processes. 
+ * Default maximum number of processes.  The process table grows in chunks
+ * of MAXPROC entries, so setMaxProcs() can raise the limit at runtime.
  */
 
 #define MAXPROC      50
@@ -34,18 +35,280 @@ extern void phase1_init(void);
 extern int  spork(char *name, int(*func)(void *), void *arg,
                   int stacksize, int priority);
 extern int  join(int *status);
+extern int  joinPid(int pid, int *status);
 extern void quit(int status) __attribute__((__noreturn__));
 extern void zap(int pid);
+extern void zapMany(int *pids, int n);
+extern int  zapTree(int pid);
 extern void blockMe(void);
 extern int  unblockProc(int pid);
+extern int  unblockProcs(int *pids, int n);
 
 extern void dispatcher(void);
 
+/*
+ * Preemption points.  A wakeup of a process that should preempt the
+ * current one sets a need-resched flag.  Interrupt handlers bracket
+ * themselves with interruptEnter() and interruptExit(); in between,
+ * wakeups leave the dispatcher call to interruptExit(), which makes it
+ * once, and only if the flag is set.  Syscall handlers call
+ * reschedIfNeeded() on their way out.  requestResched() sets the flag,
+ * e.g. from the clock handler when a quantum may have run out.
+ */
+
+extern void interruptEnter(void);
+extern void interruptExit(void);
+extern void requestResched(void);
+extern void reschedIfNeeded(void);
+
+/*
+ * Critical sections.  criticalEnter() turns interrupts off (and checks
+ * for kernel mode) and returns the old PSR for criticalExit(); keep them
+ * around the shared-state updates themselves.  For a longer path that
+ * must not be switched away from, but can take interrupts, use
+ * preemptDisable() and preemptEnable(): in between, wakeups only set the
+ * need-resched flag, and the outermost preemptEnable() acts on it.
+ * interruptEnter() and interruptExit() are the same pair.
+ *
+ * Once resetIrqsOffStats() has been called, phase 1 times every stretch
+ * with interrupts off that starts with them on, in host nanoseconds, and
+ * keeps the longest.  Until then nothing is timed, so the PSR path makes
+ * no host clock calls.
+ */
+
+extern unsigned int criticalEnter(const char *func);
+extern void         criticalExit(unsigned int old_psr);
+extern void         preemptDisable(void);
+extern void         preemptEnable(void);
+
+typedef struct IrqsOffStats {
+    long long   max_ns;     /* longest stretch with interrupts off */
+    const char *max_where;  /* the function that turned them off, that time */
+    long        sections;   /* stretches timed */
+} IrqsOffStats;
+
+extern void getIrqsOffStats(IrqsOffStats *stats);
+extern void resetIrqsOffStats(void);
+
+extern int  setScheduler(const char *name);
+
 extern int  currentTime(void);
 
 extern int  getpid(void);
 extern void dumpProcesses(void);
 
+extern int  setMaxProcs(int max);
+extern int  procSlot(int pid);
+
+/*
+ * Tuning for the default (priority) scheduler.  Both can also be set at
+ * boot, from PHASE1_QUANTUM_MS and PHASE1_AGING_MS in the environment.
+ * The quantum defaults to 80ms.  With aging, a process that has waited
+ * that many ms for the CPU moves up one priority until it gets to run;
+ * the default is 1000ms, and 0 turns it off.  Each returns the old value.
+ *
+ * getMaxRunqWait() is the longest a process of that priority has waited
+ * for the CPU since boot, in us.
+ */
+
+extern int  setQuantum(int ms);
+extern int  setAging(int ms);
+extern int  getMaxRunqWait(int priority);
+
+/*
+ * Scheduling trace.  traceStart() records enqueue, dispatch, block and
+ * unblock events, each with its own currentTime() stamp, in a ring that
+ * keeps the last nevents of them; traceRead() copies them out, oldest
+ * first.  While tracing, every switch to a process also goes into two
+ * latency histograms for its priority: runnable-to-run (since it was
+ * last put on a run queue) and, if a wakeup made it runnable,
+ * wakeup-to-run.  Bucket 0 counts 0us; bucket i counts [2^(i-1), 2^i) us.
+ * p50 and p99 are bucket bounds, capped at the max.  With tracing off,
+ * the scheduler reads the clock no more than it otherwise would.
+ *
+ * PHASE1_TRACE=<nevents> in the environment starts tracing at boot, and
+ * prints dumpSchedLatency() when testcase_main returns.
+ */
+
+#define TRACE_ENQUEUE   1
+#define TRACE_DISPATCH  2
+#define TRACE_BLOCK     3
+#define TRACE_UNBLOCK   4
+
+typedef struct TraceEvent {
+    int time;           /* currentTime() */
+    int pid;
+    int priority;
+    int type;           /* TRACE_... */
+} TraceEvent;
+
+#define LAT_BUCKETS 24
+
+typedef struct LatencyStats {
+    long count;
+    int  p50, p99, max; /* us */
+    long buckets[LAT_BUCKETS];
+} LatencyStats;
+
+extern int  traceStart(int nevents);
+extern void traceStop(void);
+extern int  traceRead(TraceEvent *events, int max);
+extern int  getSchedLatency(int priority, LatencyStats *wakeup,
+                            LatencyStats *runnable);
+extern void dumpSchedLatency(void);
+
+/*
+ * Per-process accounting.  The dispatcher charges a process for its CPU
+ * time whenever it switches away from it, and counts the switch as
+ * voluntary (the process blocked or quit) or involuntary (it was
+ * preempted).  The syscall handler calls accountSyscall(), and the device
+ * drivers call accountIO(), both on behalf of the current process.
+ * getProcInfo() returns -1 if there is no such process.  dumpTop()
+ * prints every process, the biggest CPU users first; PHASE1_TOP in the
+ * environment prints it when testcase_main returns.
+ */
+
+#define ACCT_DISK_READ   0
+#define ACCT_DISK_WRITE  1
+#define ACCT_TERM_READ   2
+#define ACCT_TERM_WRITE  3
+#define ACCT_KINDS       4
+
+#define PROC_RUNNING     0
+#define PROC_RUNNABLE    1
+#define PROC_BLOCKED     2
+#define PROC_QUIT        3      /* waiting to be joined */
+
+typedef struct ProcInfo {
+    int       pid;
+    int       ppid;
+    int       priority;
+    int       state;            /* PROC_... */
+    int       level;            /* MLFQ level, 0 the top; priority - 1 under other policies */
+    char      name[MAXNAME + 1];
+    long long cpu_us;
+    long      vol_switches;
+    long      invol_switches;
+    long      syscalls;
+    long      io_bytes[ACCT_KINDS];  /* by ACCT_... */
+} ProcInfo;
+
+extern void accountSyscall(void);
+extern void accountIO(int kind, int bytes);
+extern int  getProcInfo(int pid, ProcInfo *info);
+extern void dumpTop(void);
+
+/*
+ * Counters for the pool of process stacks that spork() draws from and
+ * join() returns to.
+ */
+
+typedef struct StackPoolStats {
+    long hits;          /* spork() reused a cached stack */
+    long misses;        /* spork() had to map a new stack */
+    long releases;      /* join() put a stack back in the pool */
+    long evictions;     /* join() unmapped a stack the pool could not hold */
+    long bytes_cached;  /* bytes of stack sitting in the pool */
+    long bytes_mapped;  /* bytes of stack mapped, in use or cached */
+} StackPoolStats;
+
+extern void getStackPoolStats(StackPoolStats *stats);
+
+/*
+ * Per-process storage for the layers above phase 1.  Every process
+ * carries PROC_DATA_SIZE bytes of it, zero-filled when the process is
+ * created.  A phase reserves its piece once, at init, and gets back a
+ * key; procData(key) is then the current process's piece.
+ * procDataRegister() returns -1 if there is not enough space left.
+ */
+
+#define PROC_DATA_SIZE 64
+
+extern int   procDataRegister(int size);
+extern void *procData(int key);
+
+/*
+ * A FIFO of blocked processes, for the layers above phase 1 to sleep on.
+ * A zero-filled WaitQueue is empty.  Each sleeper can leave a pointer
+ * (its request, its message buffer, ...) for the waker to find with
+ * waitQueuePeek().
+ *
+ * waitQueueSleep() is waitQueueAdd() followed by waitQueueBlock().  Call
+ * them separately to drop a lock in between: a wakeup that comes after
+ * the Add and before the Block is not lost, the Block just returns.
+ * The Block returns the value passed to the wake call (0 for WakeOne).
+ *
+ * A wake call runs the dispatcher once if it unblocked anyone, and
+ * returns the number of processes it took off the queue (WakeOne and
+ * WakeValue return 0 or 1).
+ */
+
+typedef struct WaitQueue {
+    void *head;         /* phase 1 private */
+    void *tail;
+    int   count;        /* processes on the queue */
+} WaitQueue;
+
+extern void  waitQueueInit     (WaitQueue *wq);
+extern void  waitQueueAdd      (WaitQueue *wq, void *data);
+extern int   waitQueueBlock    (void);
+extern int   waitQueueSleep    (WaitQueue *wq, void *data);
+extern void *waitQueuePeek     (WaitQueue *wq);
+extern void  waitQueueSplice   (WaitQueue *dst, WaitQueue *src);
+extern int   waitQueueWakeOne  (WaitQueue *wq);
+extern int   waitQueueWakeValue(WaitQueue *wq, int value);
+extern int   waitQueueWakeAll  (WaitQueue *wq, int value);
+
+/*
+ * A pool of worker processes that stay alive between tasks, so running a
+ * task costs a wakeup instead of a spork() and a join().  poolSubmit()
+ * queues func(arg) and returns a ticket.  poolCollect() blocks until
+ * some submitted task has finished, stores what func returned, and
+ * returns that task's ticket; it returns -1 if nothing is outstanding.
+ * Only the process that created the pool may destroy it; poolDestroy()
+ * returns -1 (and does nothing) while tasks are still outstanding.
+ */
+
+typedef struct WorkerPool WorkerPool;
+
+extern WorkerPool *poolCreate (char *name, int nworkers, int stacksize,
+                               int priority);
+extern int         poolSubmit (WorkerPool *pool, int (*func)(void *),
+                               void *arg);
+extern int         poolCollect(WorkerPool *pool, int *result);
+extern int         poolDestroy(WorkerPool *pool);
+
+/*
+ * Kernel work queues, for deferring work out of interrupt handlers.  A
+ * work queue is a few worker processes, at a priority of the creator's
+ * choosing, that run queued WorkItems in process context.  The caller
+ * owns each WorkItem and sets it up once with workInit(); queueWork()
+ * never allocates or blocks, so an interrupt handler can call it.  An
+ * item that is queued again before it has started runs only once;
+ * queueWork() returns 1 if it queued the item, 0 if it was already
+ * queued.  The item is off the queue by the time func runs, so func may
+ * queue it again.  workQueueFlush() blocks until the queue is empty and
+ * every worker is idle.  Only the process that created the work queue may
+ * destroy it; the workers finish what is queued first.
+ */
+
+typedef struct WorkItem {
+    void           (*func)(void *);
+    void            *arg;
+    struct WorkItem *next;      /* phase 1 private */
+    int              pending;   /* on a queue, and not started yet */
+} WorkItem;
+
+typedef struct WorkQueue WorkQueue;
+
+extern void       workInit        (WorkItem *work, void (*func)(void *),
+                                   void *arg);
+extern WorkQueue *workQueueCreate (char *name, int nworkers, int stacksize,
+                                   int priority);
+extern int        queueWork       (WorkQueue *wq, WorkItem *work);
+extern void       workQueueFlush  (WorkQueue *wq);
+extern int        workQueueDestroy(WorkQueue *wq);
+
 
 /*
  * These functions are called *BY* Phase 1 code, and are implemented in
@@ -68,27 +68,29 @@
 
 // disable terminal xmit interrupts
 // struct definitions
+// an entry in the sleep queue, kept in the process's phase1 data
+// the process sleeps on its own wait queue
 typedef struct pcb {
     int pid;
     int wakeup_cycle;
+    WaitQueue wq;
     struct pcb *next;
 } pcb;
 
 typedef struct rw_req {
-           int         pid;
            char       *buf;
            int     bufSize;
            int     *lenOut;
            int cur_buf_idx;
-    struct rw_req    *next;
 } rw_req;
 
 typedef struct term {
     char buf[MAXLINE+1];
+    int buf_idx;           // where the next character received goes in buf
     int mbox;
     int write_mbox;
-    rw_req *read_queue;
-    rw_req *write_queue;
+    WaitQueue read_queue;  // processes in kern_term_read, each waiting with its rw_req as the wait data
+    WaitQueue write_queue;
 } Terminal;
 
 typedef enum {
@@ -97,7 +99,8 @@ typedef enum {
 } Op;
 
 typedef struct disk_req {
-    int          pid;     // for unblocking
+    int          pid;
+    WaitQueue   done;     // the requesting process waits here until the request is finished
     Op            op;       // read/write
     void        *buf;   // to be read from or written to
 
@@ -119,20 +122,44 @@ typedef struct disk_state {
     int  num_tracks;
     int is_blocked;
     int        pid;
+    int    op_busy;       // devd only: an op has been sent to the disk and has not completed
+    int    op_size;       // devd only: that op is kern_disk_size's USLOSS_DISK_TRACKS, not cur_req
+    WaitQueue size_wait;  // devd only: kern_disk_size waiting for devd to get the track count
     USLOSS_DeviceRequest cur_req;
     disk_req *queue;
 } DiskState;
 
+// a device interrupt, or a request for devd's attention, waiting for devd
+typedef struct dev_event {
+    int type;
+    int unit;
+    int status;
+} DevEvent;
+
+#define DEV_EVENTS 64       // events devd has not handled yet; more are dropped
+#define DISK_KICK  -1       // status of a disk event posted when a request is queued
+
 /* FUNCTION STUBS */
 void gain_mutex(const char *func);
 void release_mutex(const char *func);
 void phase4_start_service_processes();
 void put_into_sleep_queue(pcb *proc);
-void put_into_term_queue(rw_req *req, rw_req **queue);
 void put_into_disk_queue(disk_req *req, int unit);
 void dump_disk_queue(int unit);
 void dump_sleep_queue();
 void dump_disk_state(int unit);
+void sleep_tick(int now);
+void term_event(int unit, int status);
+void disk_build_op(DiskState *disk_state);
+void disk_op_done(DiskState *disk_state);
+void disk_finish(int unit);
+void disk_start(int unit);
+void disk_event(int unit, int status);
+void post_event(int type, int unit, int status);
+void waitDeviceAny(int *type, int *unit, int *status);
+static void ev_clock_handler(int dev, void *arg);
+static void ev_term_handler(int dev, void *arg);
+static void ev_disk_handler(int dev, void *arg);
 
 // system calls
 void kern_sleep     (USLOSS_Sysargs *arg);
@@ -146,16 +173,27 @@ void kern_disk_size (USLOSS_Sysargs *arg);
 int sleepd(void *arg);
 int termd (void *arg);
 int diskd (void *arg);
+int devd  (void *arg);
 
 // globals
 int mutex;
 pcb *sleep_queue;
+int pcb_key; // our pcb's place in each process's phase1 data
 int num_cycles_since_start;
 
 // devices
 Terminal        terms[4];
 DiskState disk_states[2];
 
+// event mode: PHASE4_EVENT_LOOP in the environment replaces the seven daemons with one devd
+int event_mode;
+DevEvent dev_events[DEV_EVENTS];  // a ring, oldest first
+int dev_event_head;
+int dev_event_count;
+WaitQueue devd_wait;               // devd, when it has no events
+void (*phase2_clock_handler)(int dev, void *arg);
+int time_ofLastClock;
+
 
 void gain_mutex(const char *func) {
     /*USLOSS_Console("%s IS TRYING TO GAIN THE MUTEX!\n", func);*/
@@ -182,6 +220,13 @@ void phase4_init() {
     // gain the mutex
     gain_mutex(__func__);
     
+    // reserve room for a pcb in every process
+    pcb_key = procDataRegister(sizeof(pcb));
+    if (pcb_key < 0) {
+        USLOSS_Console("ERROR: No room for the phase4 pcb in the phase1 process data!\n");
+        USLOSS_Halt(1);
+    }
+
     // load the system call vec
     systemCallVec[SYS_SLEEP]     =      kern_sleep;
     systemCallVec[SYS_TERMREAD]  =  kern_term_read;
@@ -217,11 +262,27 @@ void phase4_init() {
         disk_state->num_tracks = -1;
     }
 
+    // one service process or seven
+    event_mode = getenv("PHASE4_EVENT_LOOP") != NULL;
+
     // release the mutex
     release_mutex(__func__);
 }
 
 void phase4_start_service_processes() {
+    if (event_mode) {
+        // take the device interrupts over from phase2, but leave it the clock's time slicing
+        unsigned int old_psr = criticalEnter(__func__);
+        phase2_clock_handler = USLOSS_IntVec[USLOSS_CLOCK_INT];
+        USLOSS_IntVec[USLOSS_CLOCK_INT] = ev_clock_handler;
+        USLOSS_IntVec[USLOSS_TERM_INT]  = ev_term_handler;
+        USLOSS_IntVec[USLOSS_DISK_INT]  = ev_disk_handler;
+        criticalExit(old_psr);
+
+        spork("devd", devd, NULL, USLOSS_MIN_STACK, 1);
+        return;
+    }
+
     // spork the sleep daemon
     spork("sleepd", sleepd, NULL, USLOSS_MIN_STACK, 1);
 
@@ -241,134 +302,147 @@ int sleepd(void *arg) {
         // call wait device to wait for a clock interrupt
         int status;
         waitDevice(USLOSS_CLOCK_DEV, 0, &status);
-        num_cycles_since_start++;
+        sleep_tick(status);
+    }
+}
+
+/* the clock reads now (us since boot) */
+void sleep_tick(int now) {
+    // cycles are 100ms of clock time, not clock messages: in virtual time USLOSS may jump over
+    // idle ticks, so one message can cover more than one cycle
+    num_cycles_since_start = now / 100000;
 
-        // wakeup any cycles whose wakeup time has arrived/passed
+    // wakeup any cycles whose wakeup time has arrived/passed
+    // they are gathered onto one wait queue, so the dispatcher runs once for all of them
+    if (sleep_queue && num_cycles_since_start >= sleep_queue->wakeup_cycle) {
+        WaitQueue expired = {0};
+
+        // gain mutex here since the sleep queue is a shared 
+        gain_mutex(__func__);
         while (sleep_queue && num_cycles_since_start >= sleep_queue->wakeup_cycle) {
-            
-            // gain mutex here since the sleep queue is a shared 
-            gain_mutex(__func__);
-            int pid_toUnblock = sleep_queue->pid;
+            waitQueueSplice(&expired, &sleep_queue->wq);
             sleep_queue = sleep_queue->next;
-            release_mutex(__func__);
-
-            unblockProc(pid_toUnblock);
         }
+        release_mutex(__func__);
+
+        waitQueueWakeAll(&expired, 0);
     }
 }
 
 /* terminal daemon */
 int termd(void *arg) {
 
-    int       unit = (int)(long)arg;
-    Terminal *term =   &terms[unit];
-    int    buf_idx =              0;
+    int unit = (int)(long)arg;
 
     // term write writes to the control register
     while (1) {
         // wait for a terminal interrupt to occur -- retrieve its status
         int status;
         waitDevice(USLOSS_TERM_DEV, unit, &status);
+        term_event(unit, status);
+    }
+}
 
-        // unpack the different parts of the status
-        char         ch = USLOSS_TERM_STAT_CHAR(status); // char recvd, if any
-        int xmit_status = USLOSS_TERM_STAT_XMIT(status);
-        int recv_status = USLOSS_TERM_STAT_RECV(status);
+/* a terminal interrupt has delivered status */
+void term_event(int unit, int status) {
+    Terminal *term = &terms[unit];
 
+    // unpack the different parts of the status
+    char         ch = USLOSS_TERM_STAT_CHAR(status); // char recvd, if any
+    int xmit_status = USLOSS_TERM_STAT_XMIT(status);
+    int recv_status = USLOSS_TERM_STAT_RECV(status);
 
-        // read from the terminal
-        if (recv_status == USLOSS_DEV_BUSY) {
-            // a character has been received in the status register
 
-            // buffer the character
-            term->buf[buf_idx++] = ch;
+    // read from the terminal
+    if (recv_status == USLOSS_DEV_BUSY) {
+        // a character has been received in the status register
 
-            if (buf_idx == MAXLINE || ch == '\n') {
-                // reset buf index
-                buf_idx = 0;
+        // buffer the character
+        term->buf[term->buf_idx++] = ch;
 
-                // conditionally send the buffer to the terminal mailbox
-                // +1 for null terminator
-                gain_mutex(__func__);
+        if (term->buf_idx == MAXLINE || ch == '\n') {
+            // reset buf index
+            term->buf_idx = 0;
 
-                MboxCondSend(term->mbox, term->buf, strlen(term->buf)+1);
-                release_mutex(__func__);
+            // conditionally send the buffer to the terminal mailbox
+            // +1 for null terminator
+            gain_mutex(__func__);
 
-                // zero out buffer
-                explicit_bzero(term->buf, MAXLINE+1);
+            MboxCondSend(term->mbox, term->buf, strlen(term->buf)+1);
+            release_mutex(__func__);
 
-                // if there is a process on the read queue, deliver to it
-                if (term->read_queue) {
+            // zero out buffer
+            explicit_bzero(term->buf, MAXLINE+1);
 
-                    // gain the mutex
-                    gain_mutex(__func__);
+            // if there is a process on the read queue, deliver to it
+            if (term->read_queue.count) {
 
-                    // dequeue the request process
-                    rw_req *req = term->read_queue;
-                    term->read_queue = term->read_queue->next;
+                // gain the mutex
+                gain_mutex(__func__);
 
-                    // deliver the chars from the terminal line
-                    MboxCondRecv(term->mbox, req->buf, MAXLINE);
+                // retrieve the request of the first process
+                rw_req *req = waitQueuePeek(&term->read_queue);
 
-                    // record the length read
-                    int buf_len = strlen(req->buf);
-                    *req->lenOut = (buf_len < req->bufSize) ? buf_len : req->bufSize;
+                // deliver the chars from the terminal line
+                MboxCondRecv(term->mbox, req->buf, MAXLINE);
 
-                    // release the mutex before unblocking the process
-                    release_mutex(__func__);
+                // record the length read
+                int buf_len = strlen(req->buf);
+                *req->lenOut = (buf_len < req->bufSize) ? buf_len : req->bufSize;
 
-                    // unblock the process
-                    unblockProc(req->pid);
-                }
+                // release the mutex before unblocking the process
+                release_mutex(__func__);
+
+                // dequeue and unblock the process
+                waitQueueWakeOne(&term->read_queue);
             }
         }
+    }
 
-        if (xmit_status == USLOSS_DEV_READY) {
-            // ready to write a character out
-            
-            if (term->write_queue) {
-                gain_mutex(__func__);
-                rw_req *req = term->write_queue;
-
-                if (req->cur_buf_idx < req->bufSize) {
-                    // read the next character from the buffer
+    if (xmit_status == USLOSS_DEV_READY) {
+        // ready to write a character out
+        
+        if (term->write_queue.count) {
+            gain_mutex(__func__);
+            rw_req *req = waitQueuePeek(&term->write_queue);
 
-                    char ch_to_write = req->buf[req->cur_buf_idx++];
+            if (req->cur_buf_idx < req->bufSize) {
+                // read the next character from the buffer
 
-                    // put together a control word to write to the control reg
-                    int cr_val = 0;
-                    cr_val = USLOSS_TERM_CTRL_CHAR(cr_val, ch_to_write);
-                    cr_val = USLOSS_TERM_CTRL_XMIT_INT(cr_val);
-                    cr_val = USLOSS_TERM_CTRL_RECV_INT(cr_val);
-                    cr_val = USLOSS_TERM_CTRL_XMIT_CHAR(cr_val);
+                char ch_to_write = req->buf[req->cur_buf_idx++];
 
-                    int err = USLOSS_DeviceOutput(USLOSS_TERM_DEV, unit, (void *)(long)cr_val);
-                    if (err == USLOSS_DEV_INVALID) {
-                        USLOSS_Console("ERROR: Failed to write character %c to terminal %d\n", ch_to_write, unit);
-                        release_mutex(__func__);
-                        USLOSS_Halt(1);
-                    }
+                // put together a control word to write to the control reg
+                int cr_val = 0;
+                cr_val = USLOSS_TERM_CTRL_CHAR(cr_val, ch_to_write);
+                cr_val = USLOSS_TERM_CTRL_XMIT_INT(cr_val);
+                cr_val = USLOSS_TERM_CTRL_RECV_INT(cr_val);
+                cr_val = USLOSS_TERM_CTRL_XMIT_CHAR(cr_val);
 
+                int err = USLOSS_DeviceOutput(USLOSS_TERM_DEV, unit, (void *)(long)cr_val);
+                if (err == USLOSS_DEV_INVALID) {
+                    USLOSS_Console("ERROR: Failed to write character %c to terminal %d\n", ch_to_write, unit);
                     release_mutex(__func__);
+                    USLOSS_Halt(1);
+                }
 
-                } else {
-                    // write the len out to the req
-                    *req->lenOut = req->bufSize;
+                release_mutex(__func__);
 
-                    // pop the process off the queue and wake it up
-                    term->write_queue = term->write_queue->next;
-                    release_mutex(__func__);
+            } else {
+                // write the len out to the req
+                *req->lenOut = req->bufSize;
 
-                    unblockProc(req->pid);
-                }
-            }
-        } 
+                // pop the process off the queue and wake it up
+                release_mutex(__func__);
 
-        if (recv_status == USLOSS_DEV_ERROR) {
-            // an error has occurred
-            USLOSS_Console("ERROR: After retrieving terminal status, the receive status is USLOSS_DEV_ERROR!\n");
-            USLOSS_Halt(1);
+                waitQueueWakeOne(&term->write_queue);
+            }
         }
+    } 
+
+    if (recv_status == USLOSS_DEV_ERROR) {
+        // an error has occurred
+        USLOSS_Console("ERROR: After retrieving terminal status, the receive status is USLOSS_DEV_ERROR!\n");
+        USLOSS_Halt(1);
     }
 }
 
@@ -430,42 +504,11 @@ int diskd(void *arg) {
             while (disk_state->queue->num_sectors != 0) {
 
                 // build request to fulfill
-                if (disk_state->cur_track != disk_state->queue->first_track) {
-                    // seek to the required first track
-                    disk_state->cur_req.opr = USLOSS_DISK_SEEK;
-                    disk_state->cur_req.reg1 = (void *)(long)disk_state->queue->first_track;
-                } else {
-                    // read/write a block
-                    disk_state->cur_req.reg1 = (void *)(long)disk_state->queue->first_sector;
-                    disk_state->cur_req.reg2 = disk_state->queue->buf;
-                    switch (disk_state->queue->op) {
-                        case READ:
-                            disk_state->cur_req.opr = USLOSS_DISK_READ;
-                            break;
-                        case WRITE:
-                            disk_state->cur_req.opr = USLOSS_DISK_WRITE;
-                            break;
-                    }
-                }
+                disk_build_op(disk_state);
 
                 int send_outcome = send_op_to_disk(unit);
                 if (send_outcome == USLOSS_DEV_READY) {
-                    switch (disk_state->cur_req.opr) {
-                        // update current track
-                        case USLOSS_DISK_SEEK:
-                            disk_state->cur_track = disk_state->queue->first_track;
-                            break;
-                        // update parameters as necessary
-                        case USLOSS_DISK_READ:
-                        case USLOSS_DISK_WRITE:
-                            disk_state->queue->num_sectors--;
-                            disk_state->queue->first_sector = (disk_state->queue->first_sector + 1) % USLOSS_DISK_TRACK_SIZE;
-                            disk_state->queue->buf += USLOSS_DISK_SECTOR_SIZE;
-                            if (disk_state->queue->first_sector == 0) disk_state->queue->first_track++;
-                            break;
-                    }
-                    // reset request slot
-                    memset(&disk_state->cur_req, 0, sizeof(USLOSS_DeviceRequest));
+                    disk_op_done(disk_state);
                 } else if (send_outcome == USLOSS_DEV_ERROR) {
                     // dequeue/unblock process if there was an error
                     USLOSS_Console("ERROR: send_op_to_disk returned USLOSS_DEV_ERROR! Breaking out of while loop and dequeueing process.\n");
@@ -477,14 +520,14 @@ int diskd(void *arg) {
             }
 
             // dequeue the request that has completed
-            int pid_toUnblock = disk_state->queue->pid;
+            disk_req *done = disk_state->queue;
 
             disk_state->queue = disk_state->queue->next;
 
             // release mutex before unblocking
             release_mutex(__func__);
 
-            unblockProc(pid_toUnblock);
+            waitQueueWakeOne(&done->done);
 
         } else {
             // block
@@ -495,6 +538,221 @@ int diskd(void *arg) {
     }
 }
 
+/* fill in cur_req with the next step of the request at the head of the queue */
+void disk_build_op(DiskState *disk_state) {
+    if (disk_state->cur_track != disk_state->queue->first_track) {
+        // seek to the required first track
+        disk_state->cur_req.opr = USLOSS_DISK_SEEK;
+        disk_state->cur_req.reg1 = (void *)(long)disk_state->queue->first_track;
+    } else {
+        // read/write a block
+        disk_state->cur_req.reg1 = (void *)(long)disk_state->queue->first_sector;
+        disk_state->cur_req.reg2 = disk_state->queue->buf;
+        switch (disk_state->queue->op) {
+            case READ:
+                disk_state->cur_req.opr = USLOSS_DISK_READ;
+                break;
+            case WRITE:
+                disk_state->cur_req.opr = USLOSS_DISK_WRITE;
+                break;
+        }
+    }
+}
+
+/* the disk has carried out cur_req: advance the request at the head of the queue past it */
+void disk_op_done(DiskState *disk_state) {
+    switch (disk_state->cur_req.opr) {
+        // update current track
+        case USLOSS_DISK_SEEK:
+            disk_state->cur_track = disk_state->queue->first_track;
+            break;
+        // update parameters as necessary
+        case USLOSS_DISK_READ:
+        case USLOSS_DISK_WRITE:
+            disk_state->queue->num_sectors--;
+            disk_state->queue->first_sector = (disk_state->queue->first_sector + 1) % USLOSS_DISK_TRACK_SIZE;
+            disk_state->queue->buf += USLOSS_DISK_SECTOR_SIZE;
+            if (disk_state->queue->first_sector == 0) disk_state->queue->first_track++;
+            break;
+    }
+    // reset request slot
+    memset(&disk_state->cur_req, 0, sizeof(USLOSS_DeviceRequest));
+}
+
+
+/* EVENT MODE
+ *
+ * devd does the work of all seven daemons.  phase4 installs its own
+ * interrupt handlers, which post each interrupt to a ring of events and
+ * wake devd; devd takes events off the ring with waitDeviceAny() and
+ * runs the same per-device code the daemons do.  The disks cannot wait
+ * for each op in devd, so they run as state machines: disk_start()
+ * sends the next op of the request at the head of the queue, and
+ * disk_event() advances the request when the op completes.  devd holds
+ * the mutex while it touches the disk queues.
+ */
+
+/* the service process */
+int devd(void *arg) {
+    while (1) {
+        int type, unit, status;
+        waitDeviceAny(&type, &unit, &status);
+
+        switch (type) {
+            case USLOSS_CLOCK_DEV:
+                sleep_tick(status);
+                break;
+            case USLOSS_TERM_DEV:
+                term_event(unit, status);
+                break;
+            case USLOSS_DISK_DEV:
+                gain_mutex(__func__);
+                disk_event(unit, status);
+                release_mutex(__func__);
+                break;
+        }
+    }
+}
+
+/* blocks until any device has an event for devd, and takes the oldest one */
+void waitDeviceAny(int *type, int *unit, int *status) {
+    unsigned int old_psr = criticalEnter(__func__);
+
+    // the handlers post with interrupts disabled, so no event comes between the check and the sleep
+    while (!dev_event_count) waitQueueSleep(&devd_wait, NULL);
+
+    DevEvent *event = &dev_events[dev_event_head];
+    *type   = event->type;
+    *unit   = event->unit;
+    *status = event->status;
+    dev_event_head = (dev_event_head + 1) % DEV_EVENTS;
+    dev_event_count--;
+
+    criticalExit(old_psr);
+}
+
+/* queues an event for devd, and wakes it */
+void post_event(int type, int unit, int status) {
+    unsigned int old_psr = criticalEnter(__func__);
+
+    if (dev_event_count == DEV_EVENTS) {
+        USLOSS_Console("ERROR: devd has %d events waiting, dropping one from device %d unit %d.\n", DEV_EVENTS, type, unit);
+    } else {
+        DevEvent *event = &dev_events[(dev_event_head + dev_event_count) % DEV_EVENTS];
+        event->type   = type;
+        event->unit   = unit;
+        event->status = status;
+        dev_event_count++;
+        waitQueueWakeOne(&devd_wait);
+    }
+
+    criticalExit(old_psr);
+}
+
+/* phase2's clock handler, plus a devd event every 100ms, as phase2 sends to its clock mailbox */
+static void ev_clock_handler(int dev, void *arg) {
+    interruptEnter();
+    int now = currentTime();
+    if (now - time_ofLastClock >= 100000) {
+        time_ofLastClock = now;
+        post_event(USLOSS_CLOCK_DEV, 0, now);
+    }
+    interruptExit();
+
+    phase2_clock_handler(dev, arg);
+}
+
+static void ev_term_handler(int dev, void *arg) {
+    int unit = (int)(long)arg;
+    int status;
+
+    interruptEnter();
+    if (USLOSS_DeviceInput(dev, unit, &status) == USLOSS_DEV_INVALID)
+        USLOSS_Console("ERROR: USLOSS_DeviceInput returned USLOSS_DEV_INVALID! Leaving %s.\n", __func__);
+    else
+        post_event(USLOSS_TERM_DEV, unit, status);
+    interruptExit();
+}
+
+/* devd knows which op is in flight on the unit, kern_disk_size's or a queued request's */
+static void ev_disk_handler(int dev, void *arg) {
+    int unit = (int)(long)arg;
+    int status;
+
+    interruptEnter();
+    if (USLOSS_DeviceInput(dev, unit, &status) == USLOSS_DEV_INVALID)
+        USLOSS_Console("ERROR: USLOSS_DeviceInput returned USLOSS_DEV_INVALID! Leaving %s.\n", __func__);
+    else
+        post_event(USLOSS_DISK_DEV, unit, status);
+    interruptExit();
+}
+
+/* dequeue the request at the head of the queue, and wake its process */
+void disk_finish(int unit) {
+    DiskState *disk_state = &disk_states[unit];
+    disk_req  *done       = disk_state->queue;
+
+    disk_state->queue = done->next;
+    waitQueueWakeOne(&done->done);
+}
+
+/* if the disk is idle, send it the next op; finish any requests with nothing left to do
+ * kern_disk_size goes ahead of the queue; every process on size_wait shares its one op */
+void disk_start(int unit) {
+    DiskState *disk_state = &disk_states[unit];
+
+    if (!disk_state->op_busy && disk_state->size_wait.count) {
+        USLOSS_DeviceRequest *req = waitQueuePeek(&disk_state->size_wait);
+        if (USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, req) == USLOSS_DEV_INVALID) {
+            USLOSS_Console("ERROR: USLOSS_DeviceOutput returned USLOSS_DEV_INVALID! Waking disk size.\n");
+            waitQueueWakeAll(&disk_state->size_wait, USLOSS_DEV_ERROR);
+        } else {
+            disk_state->op_busy = 1;
+            disk_state->op_size = 1;
+        }
+    }
+
+    while (!disk_state->op_busy && disk_state->queue) {
+        disk_req *req = disk_state->queue;
+        if (req->num_sectors == 0) {
+            disk_finish(unit);
+            continue;
+        }
+
+        disk_build_op(disk_state);
+        req->arg_validity = USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, &disk_state->cur_req);
+        if (req->arg_validity == USLOSS_DEV_INVALID) {
+            USLOSS_Console("ERROR: USLOSS_DeviceOutput returned USLOSS_DEV_INVALID! Dequeueing process.\n");
+            disk_finish(unit);
+            continue;
+        }
+        disk_state->op_busy = 1;
+    }
+}
+
+/* a request was queued (DISK_KICK), or the op devd sent has completed with status */
+void disk_event(int unit, int status) {
+    DiskState *disk_state = &disk_states[unit];
+
+    if (status != DISK_KICK && disk_state->op_busy && disk_state->op_size) {
+        disk_state->op_busy = 0;
+        disk_state->op_size = 0;
+        waitQueueWakeAll(&disk_state->size_wait, status);
+    } else if (status != DISK_KICK && disk_state->op_busy) {
+        disk_state->op_busy = 0;
+        disk_state->queue->status = status;
+
+        if (status == USLOSS_DEV_ERROR) {
+            USLOSS_Console("ERROR: the disk returned USLOSS_DEV_ERROR! Dequeueing process.\n");
+            disk_finish(unit);
+        } else {
+            disk_op_done(disk_state);
+        }
+    }
+
+    disk_start(unit);
+}
+
 
 /* kernel-side syscalls */
 
@@ -514,22 +772,22 @@ void kern_sleep(USLOSS_Sysargs *arg) {
     }
 
     // put the process into the sleep queue before sleeping
-    pcb cur_proc = {
-        .pid = getpid(),
-        .wakeup_cycle = num_cycles_since_start + clock_cycles_to_wait,
-        .next = NULL
-    };
+    pcb *cur_proc = procData(pcb_key);
+    cur_proc->pid          = getpid();
+    cur_proc->wakeup_cycle = num_cycles_since_start + clock_cycles_to_wait;
+    cur_proc->next         = NULL;
 
     // gain mutex before accessing shared variable
     gain_mutex(__func__);
 
-    put_into_sleep_queue(&cur_proc);
+    waitQueueAdd(&cur_proc->wq, NULL);
+    put_into_sleep_queue(cur_proc);
 
     // release mutex before blocking
     release_mutex(__func__);
 
     // block
-    blockMe();
+    waitQueueBlock();
 
     // regain mutex after blocking
     gain_mutex(__func__);
@@ -563,24 +821,37 @@ void kern_term_read(USLOSS_Sysargs *arg) {
 
     // pack the arguments into an easily-sendable form
     rw_req req = {
-        .pid     = getpid(),
         .buf     =      buf,
         .bufSize =  bufSize,
-        .lenOut  =  &lenOut,
-        .next    =     NULL
+        .lenOut  =  &lenOut
     };
 
     // retrieve a reference to the appropriate terminal
     Terminal *term = &terms[unit];
 
+    // a line that came in while nobody was reading is already in the mailbox
+    // only take it if no earlier reader is waiting for it
+    char line[MAXLINE+1];
+    if (!term->read_queue.count && MboxCondRecv(term->mbox, line, MAXLINE+1) >= 0) {
+        int line_len = strlen(line);
+        lenOut = (line_len < bufSize) ? line_len : bufSize;
+        memcpy(buf, line, (line_len < bufSize) ? line_len+1 : bufSize);
+
+        arg->arg2 = (void *)(long)lenOut;
+        arg->arg4 = (void *)(long)     0;
+        accountIO(ACCT_TERM_READ, lenOut);
+        release_mutex(__func__);
+        return;
+    }
+
     // add the request to the queue
-    put_into_term_queue(&req, &term->read_queue);
+    waitQueueAdd(&term->read_queue, &req);
 
     // release mutex before blocking
     release_mutex(__func__);
 
     // block while waiting for request to be fulfilled
-    blockMe();
+    waitQueueBlock();
 
     // regain mutex after blocking
     gain_mutex(__func__);
@@ -589,6 +860,7 @@ void kern_term_read(USLOSS_Sysargs *arg) {
     assert(lenOut != -1);
     arg->arg2 = (void *)(long)lenOut; // the number of chars read
     arg->arg4 = (void *)(long)     0;
+    accountIO(ACCT_TERM_READ, lenOut);
 
     // release mutex here
     release_mutex(__func__);
@@ -616,11 +888,9 @@ void kern_term_write(USLOSS_Sysargs *arg) {
 
     // pack the arguments into an easily-sendable form
     rw_req req = {
-        .pid     = getpid(),
         .buf     =      buf,
         .bufSize =  bufSize,
-        .lenOut  =  &lenOut,
-        .next    =     NULL
+        .lenOut  =  &lenOut
     };
 
 
@@ -636,13 +906,13 @@ void kern_term_write(USLOSS_Sysargs *arg) {
     gain_mutex(__func__);
 
     // add the request to the queue
-    put_into_term_queue(&req, &term->write_queue);
+    waitQueueAdd(&term->write_queue, &req);
 
     // release mutex before blocking
     release_mutex(__func__);
 
     // block while waiting for request to be fulfilled
-    blockMe();
+    waitQueueBlock();
 
     // release write resource
     MboxRecv(term->write_mbox, NULL, 0);
@@ -653,6 +923,7 @@ void kern_term_write(USLOSS_Sysargs *arg) {
     assert(lenOut != -1);
     arg->arg2 = (void *)(long)bufSize; // the number of chars written
     arg->arg4 = (void *)(long)      0;
+    accountIO(ACCT_TERM_WRITE, bufSize);
 
     DISABLE_TERM_XMIT_INT(unit);
 
@@ -676,7 +947,21 @@ void kern_disk_size(USLOSS_Sysargs *arg) {
     DiskState *disk_state = &disk_states[unit];
 
     // perform operation if it hasn't been performed before and store the result
-    if (disk_state->num_tracks == -1) {
+    if (disk_state->num_tracks == -1 && event_mode) {
+        // devd owns the disk: it sends the op when the disk is free, and hands us the status
+        USLOSS_DeviceRequest req = {
+            .opr  = USLOSS_DISK_TRACKS,
+            .reg1 = &disk_state->num_tracks,
+            .reg2 = NULL
+        };
+
+        gain_mutex(__func__);
+        waitQueueAdd(&disk_state->size_wait, &req);
+        post_event(USLOSS_DISK_DEV, unit, DISK_KICK);
+        release_mutex(__func__);
+
+        if (waitQueueBlock() == USLOSS_DEV_ERROR) USLOSS_Console("wait device in disk size returned error code\n");
+    } else if (disk_state->num_tracks == -1) {
         int status;
         // wait for the disk to become available before beginning an op
         do {
@@ -777,12 +1062,15 @@ void kern_disk_read(USLOSS_Sysargs *arg) {
     };
 
     // add request to queue for disk daemon to process
+    // on its wait queue first, so that the wakeup is not lost if the request finishes before we block
+    waitQueueAdd(&req.done, NULL);
     put_into_disk_queue(&req, unit);
 
     // block until request is fulfilled
-    blockMe();
+    waitQueueBlock();
 
     // repack return values
+    if (req.arg_validity == 0) accountIO(ACCT_DISK_READ, sectors * sector_sz);
     arg->arg1 = (void *)(long)req.status;
     arg->arg4 = (void *)(long)req.arg_validity;
 }
@@ -844,12 +1132,15 @@ void kern_disk_write(USLOSS_Sysargs *arg) {
     };
 
     // add request to queue for disk daemon to process
+    // on its wait queue first, so that the wakeup is not lost if the request finishes before we block
+    waitQueueAdd(&req.done, NULL);
     put_into_disk_queue(&req, unit);
 
     // block until request is fulfilled
-    blockMe();
+    waitQueueBlock();
 
     // repack return values
+    if (req.arg_validity == 0) accountIO(ACCT_DISK_WRITE, sectors * sector_sz);
     arg->arg1 = (void *)(long)req.status;
     arg->arg4 = (void *)(long)req.arg_validity;
 }
@@ -900,22 +1191,6 @@ void dump_sleep_queue() {
 
 }
 
-void put_into_term_queue(rw_req *req, rw_req **queue) {
-    // add the request to the back of the queue
-    rw_req *prev = NULL;
-    rw_req *cur = *queue;
-    while (cur) {
-        prev       = cur;
-        cur  = cur->next;
-    }
-
-    if (!prev) {
-        *queue = req;
-    } else {
-        cur->next = req;
-    }
-}
-
 void put_into_disk_queue(disk_req *req, int unit) {
 
     DiskState *disk_state = &disk_states[unit];
@@ -980,8 +1255,10 @@ void put_into_disk_queue(disk_req *req, int unit) {
     // release the mutex
     release_mutex(__func__);
 
-    // unblock disk if necessary
-    if (disk_state->is_blocked) {
+    // tell devd, or unblock disk if necessary
+    if (event_mode) {
+        post_event(USLOSS_DISK_DEV, unit, DISK_KICK);
+    } else if (disk_state->is_blocked) {
         // unblock
         disk_state->is_blocked = 0;
         unblockProc(disk_state->pid);